@@ -8,37 +8,145 @@
 
 /** Data fields stored inside ADC chip.
 *
+* The adc takes its input word most significant bit first, preamble leading.
+* Fields are declared from the least significant bit of \c bin up, so the
+* last one declared is the first one clocked out.
 */
 typedef union {
     /** Structured bitfield for easy settings */
     struct {
-        uint8_t preamble : 2; /**< Preamble bits, identical for all messages */
-        uint8_t en       : 1; /**< Enable bit selects adc enable */
-        uint8_t sgl      : 1; /**< Bipolar/unipolar mode selection bit */
-        uint8_t odd      : 1; /**< Selects between even/odd bit number */
-        uint8_t a        : 3; /**< Address of channel selected for conversion */
-        uint8_t en2      : 1; /**< Second enable bit selected if settings have changed */
-        uint8_t im       : 1; /**< Selects internal/external voltage source */
-        uint8_t f        : 2; /**< Selects powerline frequency rejection mode */
-        uint8_t spd      : 1; /**< Selects conversion speed & auto calibration */
         uint8_t gs       : 3; /**< Configures internal gain stage */
+        uint8_t spd      : 1; /**< Selects conversion speed & auto calibration */
+        uint8_t f        : 2; /**< Selects powerline frequency rejection mode, FA then FB */
+        uint8_t im       : 1; /**< Selects internal/external voltage source */
+        uint8_t en2      : 1; /**< Second enable bit selected if settings have changed */
+        uint8_t a        : 3; /**< Address of channel selected for conversion */
+        uint8_t odd      : 1; /**< Selects between even/odd bit number */
+        uint8_t sgl      : 1; /**< Bipolar/unipolar mode selection bit */
+        uint8_t en       : 1; /**< Enable bit selects adc enable */
+        uint8_t preamble : 2; /**< Preamble bits, identical for all messages */
     } bitfield;
     /** Binary type for SPI transmission */
     uint16_t bin;
 } adcMemory_t;
 
-void adcInit(void) {}
+static const uint8_t adcCsPin[FNIR_ADC_CHIPS] = FNIR_ADC_CS_PINS;
+static uint8_t adcWaiting; // Bit per adc held selected by adcWaitSelect
+
+static uint16_t adcCommand(adcState_t adcState,
+                           adcChannelType_t adcChannelType,
+                           adcRejectionMode_t adcRejectionMode,
+                           adcSpeed_t adcSpeed,
+                           adcGain_t adcGain);
+static adcReturn_t adcDecode(uint8_t *adcReturnBuffer);
+
+void adcInit(void) {
+    uint8_t chip;
+
+    for (chip = 0; chip < FNIR_ADC_CHIPS; chip++) {
+        adcWaitSelect(chip, 0);
+        BOARD_ADC_CS_DDR |= adcCsPin[chip];
+    }
+}
+
+void adcWaitSelect(uint8_t chip, uint8_t select) {
+    spiTransaction_t transaction;
+
+    if (chip >= FNIR_ADC_CHIPS) {
+        return;
+    }
+
+    transaction.csPort = &BOARD_ADC_CS_PORT;
+    transaction.csMask = adcCsPin[chip];
+    transaction.flags = ADC_CS_FLAGS;
+
+    spiSelect(&transaction, select);
+
+    if (select) {
+        adcWaiting |= (1<<chip);
+    } else {
+        adcWaiting &= ~(1<<chip);
+    }
+}
+
+uint8_t adcIsWaiting(void) {
+#ifdef FNIR_ADC_USART_ENABLE
+    return (0); // Adc has USART1 to itself
+#else
+    return (adcWaiting);
+#endif
+}
 
-adcReturn_t adcSelect(adcState_t adcState,
+adcReturn_t adcSelect(uint8_t chip,
+                      adcState_t adcState,
                       adcChannelType_t adcChannelType,
                       adcRejectionMode_t adcRejectionMode,
                       adcSpeed_t adcSpeed,
                       adcGain_t adcGain) {
 
-    adcMemory_t adcMemory;
+    return (adcSelectWord(chip, adcCommand(adcState, adcChannelType, adcRejectionMode, adcSpeed, adcGain)));
+}
+
+adcReturn_t adcSelectWord(uint8_t chip, uint16_t adcWord) {
+    spiTransaction_t transaction;
+    uint8_t buffer[3];
+
+    // Command word followed by a dummy byte clocking out rest of result
+    buffer[0] = (uint8_t) (adcWord>>8);
+    buffer[1] = (uint8_t) adcWord;
+    buffer[2] = 0x00;
+
+    transaction.txBuffer = buffer;
+    transaction.rxBuffer = buffer;
+    transaction.length = 3;
+    transaction.csPort = &BOARD_ADC_CS_PORT;
+    transaction.csMask = (chip < FNIR_ADC_CHIPS) ? adcCsPin[chip] : 0x00;
+    transaction.flags = ADC_CS_FLAGS;
+
+#ifdef FNIR_ADC_USART_ENABLE
+    (void) uspiTransfer(&transaction);
+#else
+    spiTransfer(&transaction);
+#endif
+
+    return (adcDecode(buffer));
+}
+
+/** Decodes a received adc output word.
+*
+* @param adcReturnBuffer The 3 bytes clocked out of the adc.
+* @return Struct containing voltage value and adc state information.
+*/
+static adcReturn_t adcDecode(uint8_t *adcReturnBuffer) {
     adcReturn_t adcReturn;
-    uint8_t adcReturnBuffer[3];
 
+    // Output word is EOC, DMY, SIG, MSB, 15 more data bits then 5 sub LSBs
+    adcReturn.conversionOngoing = (adcReturnBuffer[0]>>7) & 0x01;
+    adcReturn.overRange = ((adcReturnBuffer[0] & 0x30) == 0x30); // SIG & MSB set
+    adcReturn.underRange = ((adcReturnBuffer[0] & 0x30) == 0x00); // SIG & MSB clear
+
+    // SIG through LSB form an offset binary code, remove offset for two's complement
+    adcReturn.returnValue = (int32_t) ((((uint32_t) (adcReturnBuffer[0] & 0x3F))<<11)
+                                       | (((uint16_t) adcReturnBuffer[1])<<3)
+                                       | (adcReturnBuffer[2]>>5))
+                            - 0x10000L;
+
+    return (adcReturn);
+}
+
+/** Builds command word selecting next conversion
+*
+* @return 16 bit command word, first byte to send in the upper 8 bits.
+*/
+static uint16_t adcCommand(adcState_t adcState,
+                           adcChannelType_t adcChannelType,
+                           adcRejectionMode_t adcRejectionMode,
+                           adcSpeed_t adcSpeed,
+                           adcGain_t adcGain) {
+
+    adcMemory_t adcMemory;
+
+    adcMemory.bin = 0x0000; // Null selections leave their bits cleared
     adcMemory.bitfield.preamble = 0x02; // All commands begin with 0b10
 
     // Set enable bits
@@ -262,13 +370,9 @@ adcReturn_t adcSelect(adcState_t adcState,
     // Set bits for powerline noise rejection
     switch (adcRejectionMode) {
         case REJECT_50HZ :
-            adcMemory.bitfield.f = 0x00;
-            break;
         case REJECT_60HZ :
-            adcMemory.bitfield.f = 0x01;
-            break;
         case REJECT_50HZ_60HZ :
-            adcMemory.bitfield.f = 0x02;
+            adcMemory.bitfield.f = ADC_REJECTION_BITS(adcRejectionMode);
             break;
         default :
             break;
@@ -316,24 +420,5 @@ adcReturn_t adcSelect(adcState_t adcState,
             break;
     }
 
-    // Put new command into adc, return result
-    adcReturnBuffer[0] = spiXfr((uint8_t) (adcMemory.bin>>8));
-    adcReturnBuffer[1] = spiXfr((uint8_t) adcMemory.bin);
-    adcReturnBuffer[2] = spiXfr(0x00);
-
-    if (adcReturnBuffer[0] & (1<<7)) {
-        adcReturn.conversionStatus = ONGOING;
-    } else {
-        adcReturn.conversionStatus = FINISHED;
-    }
-
-    if (adcReturnBuffer[0] & (1<<5)) {
-        adcReturn.returnSign = POSITIVE;
-    } else {
-        adcReturn.returnSign = NEGATIVE;
-    }
-
-    adcReturn.returnValue = (((uint16_t) adcReturnBuffer[0])<<11) & (((uint16_t) adcReturnBuffer[1])<<4) & (((uint16_t) adcReturnBuffer[2])>>4);
-
-    return (adcReturn);
+    return (adcMemory.bin);
 }
@@ -4,13 +4,19 @@
 * @date 8/2014
 *
 * The adc will begin its measurement after the program calls \ref adcSelect.
+* Several adcs may share the SPI bus, each with its own chip select pin on
+* \c BOARD_ADC_CS_PORT listed in \c FNIR_ADC_CS_PINS; every call names the chip it talks to
+* by its index in that table, and the chip is selected for the transfer
+* only. A conversion carries on with the chip deselected, so conversions on
+* several chips can overlap, and \ref adcWaitSelect reselects a chip to watch
+* its SDO line for end of conversion.
 * The proper enumerated type names are defined below. When appropriate, such
 * as when shutting down the adc or requesting a repeat measurement, null
 * types may be used, which will have no effect on the data sent to the adc.
 *
-* \ref adcSelect returns a struct which contains a conversion status, polarity
-* voltage level, which can be used together to determine error conditions and
-* adc state.
+* \ref adcSelect returns a packed struct which contains the full 17 bit signed
+* conversion result, conversion status and over/under range flags, which can
+* be used together to determine error conditions and adc state.
 *
 * The following is an example of capturing a positive unipolar voltage level
 * referenced to common (ground) and passing it to \c doSomethingWithVoltage :
@@ -19,7 +25,8 @@
 * adcReturn_t voltageLevel; // adcSelect returns a struct containing voltage,
 *                           // conversion status and polarity information
 *
-* voltageLevel = adcSelect(ENABLE,         // Enable adc
+* voltageLevel = adcSelect(0,              // First adc on bus
+*                          ENABLE,         // Enable adc
 *                          UNIPOLAR_CH_0,  // Select channel 0, ref to common
 *                          REJECT_60HZ,    // Reject 60hz powerline noise
 *                          AUTO_CALIBRATE, // Slower but more accurate speed
@@ -33,7 +40,8 @@
 * And this is an example of re-running the last conversion:
 *
 * @code
-* voltageLevel = adcSelect(REPEAT,         // Repeat last conversion
+* voltageLevel = adcSelect(0,              // First adc on bus
+*                          REPEAT,         // Repeat last conversion
 *                          NULL_CH,        // Don't change channel
 *                          NULL_REJECTION, // or rejection
 *                          NULL_SPEED,     // or speed
@@ -49,7 +57,8 @@
 * adcReturn_t voltageLevel; // adcSelect returns a struct containing voltage,
 *                           // conversion status and polarity information
 *
-* voltageLevel = adcSelect(ENABLE,           // Enable adc
+* voltageLevel = adcSelect(0,                // First adc on bus
+*                          ENABLE,           // Enable adc
 *                          INTERNAL_TEMP_CH, // Select channel 0, ref to common
 *                          REJECT_60HZ,      // Reject 60hz powerline noise
 *                          NULL_SPEED,       // Temp monitor autoselects speed
@@ -60,23 +69,51 @@
 * @endcode
 */
 
+#define FNIR_ADC_CHIPS MONTAGE_ADC_CHIPS /**< Number of adcs on the SPI bus, set by the montage */
+
+#ifndef FNIR_ADC_CS_PINS
+#define FNIR_ADC_CS_PINS {BOARD_ADC_CS_PIN} /**< Default chip select pin masks on \c BOARD_ADC_CS_PORT, one per adc */
+#endif
+
+#define ADC_CS_FLAGS (SPI_SELECT_HIGH | SPI_MSB_FIRST) /**< Chip select polarity of the board, adc words are MSB first */
+#define ADC_INPUTS 16 /**< Unipolar inputs per adc */
+
 /** Structure returned by \ref adcSelect
 *
+* Packed into 3 bytes. \c returnValue is the sign bit and 16 data bits of the
+* adc output word as a two's complement number of LSBs: 0 is zero volts and
+* +/-32768 is +/-0.5 VREF/gain full scale. At or beyond full scale the
+* reading saturates and the matching range flag is set.
 */
-typedef struct {
-    /** Status of conversion. */
-    enum conversionStatus {
-        ONGOING, /**< Conversion is still ongoing. */
-        FINISHED /**< Conversion has finished. */
-    } conversionStatus;
-    /** Polarity of measured voltage. */
-    enum returnSign {
-        POSITIVE, /**< Posivitive voltage measured. */
-        NEGATIVE /**< Negative voltage measured. */
-    } returnSign;
-    uint16_t returnValue; /**< Voltage measured on channel. */
+typedef struct __attribute__((packed)) {
+    int32_t returnValue : 17; /**< Voltage measured on channel, signed LSBs. */
+    uint8_t conversionOngoing : 1; /**< Conversion was still ongoing, result is stale. */
+    uint8_t overRange : 1; /**< Input at or above positive full scale. */
+    uint8_t underRange : 1; /**< Input below negative full scale. */
 } adcReturn_t;
 
+#define ADC_FULL_SCALE 32768L /**< returnValue at positive full scale */
+
+/** FA and FB bits of a rejection mode: 00 rejects 50Hz and 60Hz, 01 50Hz
+* and 10 60Hz.
+*/
+#define ADC_REJECTION_BITS(rejection) \
+    (((rejection) == REJECT_50HZ) ? 0x01 : (((rejection) == REJECT_60HZ) ? 0x02 : 0x00))
+
+/** Command word enabling a conversion, bit positions follow the adc memory
+* bitfield so a word built at compile time matches what \ref adcSelect sends.
+* The word is sent most significant bit first: preamble 10, EN, SGL, ODD,
+* A2-A0, then EN2, IM, FA, FB, SPD and GS2-GS0. Rejection, speed and gain take
+* the enum values below.
+*/
+#define ADC_WORD(sgl, odd, a, im, rejection, speed, gain) \
+    ((uint16_t) (0x8000 | (1<<13) | ((uint16_t) (sgl)<<12) | ((uint16_t) (odd)<<11) | ((uint16_t) (a)<<8) \
+                 | (1<<7) | ((im)<<6) | (ADC_REJECTION_BITS(rejection)<<4) | ((speed)<<3) | (gain)))
+#define ADC_WORD_UNIPOLAR(input, rejection, speed, gain) \
+    ADC_WORD(1, ((input) & 0x01), ((input)>>1), 0, rejection, speed, gain) /**< Unipolar input 0-15 against common */
+#define ADC_WORD_TEMPERATURE(rejection) ADC_WORD(0, 0, 0, 1, rejection, 0, 0) /**< Internal temperature sensor */
+#define ADC_WORD_DOUBLE_SPEED ((uint16_t) 1<<3) /**< Speed bit, set for \c DOUBLE_SPEED */
+
 /** Set mode of ADC
 *
 */
@@ -160,16 +197,40 @@ typedef enum {
     NULL_GAIN
 } adcGain_t;
 
-/** Initializes adc chip, not currently used.
+/** Initializes chip select pins.
+*
+* Drives every pin in \c FNIR_ADC_CS_PINS as an output with its adc
+* deselected.
 *
 * @return Function does not return a value.
 */
 extern void adcInit(void);
 
+/** Selects or deselects an adc outside a transfer.
+*
+* While selected the adc drives SDO low once its conversion is complete.
+*
+* @param chip   Index of adc in \c FNIR_ADC_CS_PINS.
+* @param select Nonzero to select.
+*/
+extern void adcWaitSelect(uint8_t chip, uint8_t select);
+
+/** Reports whether an adc is held selected on the SPI bus.
+*
+* A selected adc takes any clock on the bus as a read of its result, so
+* other devices on the bus must wait until this reads zero.
+*
+* @return Nonzero while \ref adcWaitSelect holds an adc on the SPI bus
+*         selected.
+*/
+extern uint8_t adcIsWaiting(void);
+
 /** Starts a new adc conversion and returns last result.
 *
-* SPI system should be initialized before using this.
+* SPI system should be initialized before using this. The function blocks
+* until the transfer is complete.
 *
+* @param chip             Index of adc in \c FNIR_ADC_CS_PINS.
 * @param adcState         Selects current state of adc.
 * @param adcChannelType   Selects desired channel from adc.
 * @param adcRejectionMode Selects powerline noise rejection filter frequency.
@@ -179,8 +240,21 @@ extern void adcInit(void);
 * @return                 Returns struct containing voltage value and adc state
 *                          information.
 */
-extern adcReturn_t adcSelect(adcState_t adcState,
+extern adcReturn_t adcSelect(uint8_t chip,
+                             adcState_t adcState,
                              adcChannelType_t adcChannelType,
                              adcRejectionMode_t adcRejectionMode,
                              adcSpeed_t adcSpeed,
                              adcGain_t adcGain);
+
+/** Starts a new adc conversion from a prepared command word.
+*
+* Same as \ref adcSelect with the command word already built, such as one
+* from \ref ADC_WORD_UNIPOLAR.
+*
+* @param chip    Index of adc in \c FNIR_ADC_CS_PINS.
+* @param adcWord Command word, first byte to send in the upper 8 bits.
+* @return        Returns struct containing voltage value and adc state
+*                information.
+*/
+extern adcReturn_t adcSelectWord(uint8_t chip, uint16_t adcWord);
@@ -0,0 +1,92 @@
+/** @file FnirBoard.h
+* @brief fNIR Imager board support
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Everything tied to the target part and its wiring: status LED, LED FET
+* port, SPI, adc and dataflash pins, end of conversion interrupt and the RAM and EEPROM
+* sizes buffer depths are derived from. The acquisition, protocol and DSP
+* code only use the names defined here, so the same sources build for any
+* part below by setting \c MCU in the makefile:
+*
+* | MCU         | SRAM | EEPROM | CDC endpoints |
+* |-------------|-----:|-------:|--------------:|
+* | atmega16u2  |  512 |    512 |            16 |
+* | atmega32u2  | 1024 |   1024 |            16 |
+* | atmega32u4  | 2560 |   1024 |            64 |
+* | at90usb1287 | 8192 |   4096 |            64 |
+*
+* All four parts bring SPI out on PB1 to PB3, USART1 on PD2, PD3 and PD5 and a
+* full port D, so the headband connector is wired the same way on each.
+*/
+
+#ifndef _FNIR_BOARD_H_
+#define _FNIR_BOARD_H_
+
+#include <avr/io.h>
+
+#if defined(__AVR_ATmega16U2__) || defined(__AVR_ATmega32U2__)
+#define BOARD_CDC_EPSIZE 16 /**< CDC data endpoint size, 176 bytes of USB DPRAM */
+#elif defined(__AVR_ATmega32U4__) || defined(__AVR_AT90USB1287__)
+#define BOARD_CDC_EPSIZE 64 /**< CDC data endpoint size, full speed bulk maximum */
+#else
+#error "Unsupported MCU, add its pins to Config/FnirBoard.h"
+#endif
+
+#if defined(FNIR_SOURCES) && (FNIR_SOURCES > 4)
+#error "LED port drives at most 4 dual wavelength sources"
+#endif
+
+#if defined(FNIR_ADC_USART_ENABLE) && defined(FNIR_SOURCES) && (FNIR_SOURCES > 2)
+#error "LED port drives at most 2 dual wavelength sources beside USART1"
+#endif
+
+#define BOARD_RAM_BYTES (RAMEND - RAMSTART + 1) /**< SRAM of the target part */
+#define BOARD_EEPROM_BYTES (E2END + 1) /**< EEPROM of the target part */
+#define BOARD_RAM_SCALE (BOARD_RAM_BYTES/512) /**< SRAM in multiples of the ATmega16u2's, scales buffer defaults */
+
+// Status LED
+#define BOARD_STATUS_DDR DDRB
+#define BOARD_STATUS_PORT PORTB
+#define BOARD_STATUS_PIN (1<<PB7)
+
+// LED FETs, source n drives 730nm on pin 2n and 850nm on pin 2n+1
+#define BOARD_LED_DDR DDRD
+#define BOARD_LED_PORT PORTD
+#ifdef FNIR_ADC_USART_ENABLE
+// USART1 takes PD2, PD3 and PD5, source 1 moves to PD6 and PD7
+#define BOARD_LED_PIN(source, wavelength) (1<<(((source) ? PD6 : PD0) + (wavelength))) /**< Pin mask of a source and wavelength */
+#define BOARD_LED_PINS ((1<<PD0)|(1<<PD1)|(1<<PD6)|(1<<PD7)) /**< LED pins left beside USART1 */
+#else
+#define BOARD_LED_PIN(source, wavelength) (1<<(PD0 + ((source)<<1) + (wavelength))) /**< Pin mask of a source and wavelength */
+#define BOARD_LED_PINS 0xFF /**< Whole port drives LEDs */
+#endif
+
+// SPI master outputs, MISO stays an input
+#define BOARD_SPI_DDR DDRB
+#define BOARD_SPI_PINS ((1<<PB1)|(1<<PB2))
+
+// Adc chip selects
+#define BOARD_ADC_CS_DDR DDRB
+#define BOARD_ADC_CS_PORT PORTB
+#define BOARD_ADC_CS_PIN (1<<PB6) /**< Chip select of a single adc */
+
+// Dataflash chip select, active low
+#define BOARD_FLASH_CS_DDR DDRB
+#define BOARD_FLASH_CS_PORT PORTB
+#define BOARD_FLASH_CS_PIN (1<<PB4)
+
+// Adc SDO, high until conversion completes
+#ifdef FNIR_ADC_USART_ENABLE
+#define BOARD_ADC_BUSY() (PIND & (1<<PD2)) /**< Adc SDO on RXD1 */
+#define BOARD_ADC_EOC_INT_ENABLE() do {EICRA |= (1<<ISC21); EIFR = (1<<INTF2); EIMSK |= (1<<INT2);} while (0) /**< Interrupt on falling SDO */
+#define BOARD_ADC_EOC_INT_DISABLE() EIMSK &= ~(1<<INT2)
+#define BOARD_ADC_EOC_vect INT2_vect
+#else
+#define BOARD_ADC_BUSY() (PINB & (1<<PB3)) /**< Adc SDO on MISO */
+#define BOARD_ADC_EOC_INT_ENABLE() do {PCIFR = (1<<PCIF0); PCMSK0 |= (1<<PCINT3); PCICR |= (1<<PCIE0);} while (0) /**< Interrupt on SDO change */
+#define BOARD_ADC_EOC_INT_DISABLE() PCMSK0 &= ~(1<<PCINT3)
+#define BOARD_ADC_EOC_vect PCINT0_vect
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+/** @file FnirConfig.h
+* @brief fNIR Imager build configuration
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Compile time switches for optional firmware features. Everything here is
+* disabled by default so the stock build keeps its RAM and flash footprint on
+* the ATmega16u2; uncomment a token (or pass it through \c CC_FLAGS in the
+* makefile) to build the feature in. Tuning values left undefined fall back to
+* the defaults given in each module's header. Buffer depths default to the
+* ATmega16u2 figures scaled by the RAM and EEPROM of the target part, see
+* FnirBoard.h.
+*/
+
+#ifndef _FNIR_CONFIG_H_
+#define _FNIR_CONFIG_H_
+
+#define FNIR_CHANNELS                      MONTAGE_CHANNELS /**< Number of measurement channels scanned, set by the montage */
+#define FNIR_SOURCES                       MONTAGE_SOURCES /**< Number of dual wavelength LED sources, set by the montage */
+#define FNIR_CHANNEL_BYTES                 ((FNIR_CHANNELS + 7)>>3) /**< Bytes of a bitmap holding one bit per channel */
+
+// On-device biquad filter bank, see iir.h
+//#define FNIR_IIR_ENABLE
+//#define FNIR_IIR_SECTIONS                1
+//#define FNIR_IIR_CHANNELS                16
+//#define FNIR_IIR_RAM_BUDGET              (288*BOARD_RAM_SCALE)
+
+// Motion artifact detector, see artifact.h
+//#define FNIR_ARTIFACT_ENABLE
+//#define FNIR_ARTIFACT_THRESHOLD          2000
+//#define FNIR_ARTIFACT_HOLD               2
+
+// Running signal quality statistics, see stats.h
+//#define FNIR_STATS_ENABLE
+//#define FNIR_STATS_CHANNELS              16
+//#define FNIR_STATS_WINDOW                8
+
+// Adaptive dark current tracking, see dark.h
+//#define FNIR_DARK_TRACK_ENABLE
+//#define FNIR_DARK_INTERVAL               16
+//#define FNIR_DARK_SHIFT                  2
+
+// Internal temperature monitoring and drift correction, see temp.h
+//#define FNIR_TEMP_ENABLE
+//#define FNIR_TEMP_INTERVAL               8
+//#define FNIR_TEMP_DARK_THRESHOLD         32
+
+// Calibrated LED settle delays, see settle.h
+//#define FNIR_SETTLE_ENABLE
+//#define FNIR_SETTLE_REFERENCE_US         10000
+//#define FNIR_SETTLE_TOLERANCE            16
+
+// Dark-lit-dark bracketed ambient rejection sequence
+//#define FNIR_BRACKET_ENABLE
+
+// Timer 0 LED intensity control and closed loop, see led.h
+//#define FNIR_LED_PWM_ENABLE
+//#define FNIR_LED_TARGET                  19661
+
+// Offset corrected double speed conversions, see speed.h
+//#define FNIR_SPEED_ENABLE
+//#define FNIR_SPEED_INTERVAL              32
+
+// Adc on USART1 in master SPI mode, at most 2 sources, see uspi.h
+//#define FNIR_ADC_USART_ENABLE
+
+// Chip selects of the montage's adcs sharing the SPI bus, see 2494_adc.h
+//#define FNIR_ADC_CS_PINS                 {(1<<PB6), (1<<PB5)}
+
+// Idle sleep while waiting, see sched.h
+//#define FNIR_SLEEP_ENABLE
+
+// Sequence numbered data lines held across disconnects, see main.c
+//#define FNIR_USB_BUFFER_ENABLE
+//#define FNIR_USB_BUFFER_RECORDS          8
+
+// EEPROM session profile and autostart, see profile.h
+//#define FNIR_PROFILE_ENABLE
+//#define FNIR_PROFILE_SIZE                224
+
+// EEPROM calibration table applied on device, see cal.h
+//#define FNIR_CAL_ENABLE
+
+// Timer 1 cycle profiling of pipeline stages, see prof.h
+//#define FNIR_PROF_ENABLE
+
+// Stack painting and RAM headroom report, see mem.h
+//#define FNIR_MEM_ENABLE
+
+// Scan timing jitter histograms, see jitter.h
+//#define FNIR_JITTER_ENABLE
+
+// USB transport counters, see usbstat.h
+//#define FNIR_USB_STATS_ENABLE
+
+// Untethered recording to AT45DB dataflash, see flash.h
+//#define FNIR_FLASH_ENABLE
+//#define FNIR_FLASH_AT45DB321C
+//#define FNIR_FLASH_CS_PIN                (1<<PB4)
+
+#endif
@@ -0,0 +1,191 @@
+# montage.awk - generates montage.h from a montage description
+#
+# Usage: awk -f Montage/montage.awk Montage/standard.txt > montage.h
+#
+# Checks the description against what the scan code assumes and writes the
+# montage as initializer macros, which main.c turns into PROGMEM tables.
+# See Montage/standard.txt for the description format.
+
+function fail(message) {
+    printf("%s:%d: %s\n", FILENAME, FNR, message) > "/dev/stderr"
+    failed = 1
+    exit 1
+}
+
+function failEnd(message) {
+    printf("%s: %s\n", FILENAME, message) > "/dev/stderr"
+    failed = 1
+    exit 1
+}
+
+function isNumber(text) {
+    return (text ~ /^[0-9]+$/)
+}
+
+# Prints one initializer macro, entries separated by commas
+function initializer(macro, comment, count, table,    i, line) {
+    line = "#define " macro " {"
+    for (i = 0; i < count; i++) {
+        line = line table[i] ((i < (count - 1)) ? ", " : "")
+    }
+    printf("%s} /**< %s */\n", line, comment)
+}
+
+BEGIN {
+    sources = 0; detectors = 0; channels = 0; orders = 0; adcs = 0
+    rejection = "REJECT_60HZ"
+    gainName[1] = "GAIN_1X"; gainName[2] = "GAIN_2X"; gainName[4] = "GAIN_4X"
+    gainName[8] = "GAIN_8X"; gainName[16] = "GAIN_16X"; gainName[32] = "GAIN_32X"
+    gainName[64] = "GAIN_64X"; gainName[128] = "GAIN_128X"
+}
+
+{
+    sub(/#.*/, "")
+}
+
+NF == 0 {
+    next
+}
+
+$1 == "name" {
+    if (NF != 2) fail("name takes one word")
+    name = $2
+    next
+}
+
+$1 == "rejection" {
+    if ((NF == 2) && ($2 == "50")) rejection = "REJECT_50HZ"
+    else if ((NF == 2) && ($2 == "60")) rejection = "REJECT_60HZ"
+    else if ((NF == 2) && ($2 == "50/60")) rejection = "REJECT_50HZ_60HZ"
+    else fail("rejection must be 50, 60 or 50/60")
+    next
+}
+
+$1 == "wavelengths" {
+    if ((NF != 3) || !isNumber($2) || !isNumber($3)) fail("board drives two wavelengths per source, give both in nm")
+    wavelengths = $2 ", " $3
+    next
+}
+
+$1 == "source" {
+    if (NF != 2) fail("source takes a name")
+    if ($2 in sourceIndex) fail("source " $2 " declared twice")
+    sourceIndex[$2] = sources++
+    next
+}
+
+$1 == "detector" {
+    if (NF != 5) fail("detector takes a name, adc, input and gain")
+    if ($2 in detectorIndex) fail("detector " $2 " declared twice")
+    if (!isNumber($3)) fail("adc must be a number")
+    if (!isNumber($4) || ($4 > 15)) fail("input must be 0 to 15")
+    if (!isNumber($5) || !(($5 + 0) in gainName)) fail("gain must be 1, 2, 4, 8, 16, 32, 64 or 128")
+    if ((($3 * 16) + $4) in inputDetector) fail("detector " $2 " shares adc " $3 " input " $4 " with " inputDetector[($3 * 16) + $4])
+    inputDetector[($3 * 16) + $4] = $2
+    detectorIndex[$2] = detectors
+    detectorAdc[detectors] = $3 + 0
+    detectorInput[detectors] = $4 + 0
+    detectorGain[detectors] = gainName[$5 + 0]
+    detectors++
+    if (($3 + 1) > adcs) adcs = $3 + 1
+    next
+}
+
+$1 == "channel" {
+    if (NF != 3) fail("channel takes a source and a detector")
+    if (!($2 in sourceIndex)) fail("unknown source " $2)
+    if (!($3 in detectorIndex)) fail("unknown detector " $3)
+    channelSource[channels] = sourceIndex[$2]
+    channelDetector[channels] = detectorIndex[$3]
+    channels++
+    next
+}
+
+$1 == "order" {
+    for (i = 2; i <= NF; i++) {
+        if (!isNumber($i)) fail("order takes channel numbers")
+        order[orders++] = $i + 0
+    }
+    next
+}
+
+{
+    fail("unknown keyword " $1)
+}
+
+END {
+    if (failed) exit 1
+
+    if (name == "") failEnd("no name given")
+    if (wavelengths == "") failEnd("no wavelengths given")
+    if (sources == 0) failEnd("no sources declared")
+    if (channels == 0) failEnd("no channels declared")
+    if (channels > 255) failEnd("at most 255 channels")
+    if (channels % adcs) failEnd(channels " channels cannot be split evenly over " adcs " adcs")
+
+    groups = channels / adcs
+
+    # Blocks of channels per adc, converted and lit together
+    for (c = 0; c < channels; c++) {
+        if (detectorAdc[channelDetector[c]] != int(c / groups)) failEnd("channel " c " must be on adc " int(c / groups))
+        if (channelSource[c] != channelSource[c % groups]) failEnd("channel " c " is converted with channel " (c % groups) " and must share its source")
+    }
+
+    for (s = 0; s < sources; s++) {
+        sourceChannel[s] = -1
+        for (c = groups - 1; c >= 0; c--) {
+            if (channelSource[c] == s) sourceChannel[s] = c
+        }
+        if (sourceChannel[s] < 0) failEnd("source " s " lights no channel of adc 0")
+    }
+
+    # Scan order defaults to channel order, frame tasks key on channel 0
+    if (orders == 0) {
+        for (c = 0; c < groups; c++) order[orders++] = c
+    }
+    if (orders != groups) failEnd("order must list each of the " groups " channels of adc 0 once")
+    for (i = 0; i < orders; i++) {
+        if ((order[i] >= groups) || (order[i] in ordered)) failEnd("order must list each of the " groups " channels of adc 0 once")
+        ordered[order[i]] = 1
+    }
+    if (order[0] != 0) failEnd("order must start at channel 0")
+
+    # Bracketed sequence scans channels sharing a detector back to back
+    bracketCount = 0
+    for (d = 0; d < (adcs * 16); d++) {
+        for (c = 0; c < channels; c++) {
+            if (((detectorAdc[channelDetector[c]] * 16) + detectorInput[channelDetector[c]]) == d) bracket[bracketCount++] = c
+        }
+    }
+
+    for (c = 0; c < channels; c++) {
+        source[c] = channelSource[c]
+        input[c] = detectorInput[channelDetector[c]]
+        gain[c] = detectorGain[channelDetector[c]]
+        command[c] = "ADC_WORD_UNIPOLAR(" input[c] ", " rejection ", AUTO_CALIBRATE, " gain[c] ")"
+    }
+
+    printf("/** @file montage.h\n")
+    printf("* @brief Montage tables for the %s headband\n", name)
+    printf("*\n")
+    printf("* Generated by Montage/montage.awk from %s, do not edit.\n", FILENAME)
+    printf("*/\n\n")
+    printf("#define MONTAGE_NAME \"%s\" /**< Montage name */\n", name)
+    printf("#define MONTAGE_CHANNELS %d /**< Measurement channels */\n", channels)
+    printf("#define MONTAGE_SOURCES %d /**< Dual wavelength LED sources */\n", sources)
+    printf("#define MONTAGE_ADC_CHIPS %d /**< Adcs on the SPI bus */\n", adcs)
+    printf("#define MONTAGE_REJECTION %s /**< Powerline rejection of every conversion */\n", rejection)
+    printf("#define MONTAGE_WAVELENGTHS {%s} /**< LED wavelengths in nm, board pin order */\n", wavelengths)
+    initializer("MONTAGE_SOURCE", "LED source lighting each channel", channels, source)
+    initializer("MONTAGE_SOURCE_CHANNEL", "First channel lit by each source", sources, sourceChannel)
+    initializer("MONTAGE_INPUT", "Adc input of each channel's detector", channels, input)
+    initializer("MONTAGE_GAIN", "Adc gain of each channel's detector", channels, gain)
+    initializer("MONTAGE_SCAN_ORDER", "Scan order of adc 0's channels", orders, order)
+    initializer("MONTAGE_BRACKET_ORDER", "Scan order grouping channels by detector", bracketCount, bracket)
+    printf("\n/** Auto calibrated command word of each channel */\n")
+    printf("#define MONTAGE_COMMAND {")
+    for (c = 0; c < channels; c++) {
+        printf(" \\\n    %s%s", command[c], ((c < (channels - 1)) ? "," : ""))
+    }
+    printf(" \\\n}\n")
+}
@@ -0,0 +1,91 @@
+/** @file artifact.c
+* @brief Streaming motion artifact detector
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_ARTIFACT_ENABLE
+
+/** Detector history of one channel. */
+typedef struct {
+    int16_t previous[2]; /**< Last 730nm and 850nm samples */
+    uint8_t hold; /**< Frames remaining with flag set */
+} artifactState_t;
+
+static artifactState_t artifactState[FNIR_CHANNELS];
+static uint8_t artifactPrimed[FNIR_CHANNEL_BYTES]; // One bit per channel, set once history is valid
+static uint16_t artifactThreshold;
+static uint8_t artifactHold;
+static uint8_t artifactEnabled;
+
+void artifactInit(void) {
+    artifactThreshold = FNIR_ARTIFACT_THRESHOLD;
+    artifactHold = FNIR_ARTIFACT_HOLD;
+    artifactEnabled = 0;
+    memset(artifactPrimed, 0, sizeof(artifactPrimed));
+}
+
+void artifactEnable(uint8_t enable) {
+    if (enable && !artifactEnabled) {
+        memset(artifactPrimed, 0, sizeof(artifactPrimed));
+    }
+
+    artifactEnabled = enable;
+}
+
+uint8_t artifactIsEnabled(void) {
+    return (artifactEnabled);
+}
+
+void artifactSetThreshold(uint16_t threshold) {
+    artifactThreshold = threshold;
+}
+
+void artifactSetHold(uint8_t holdFrames) {
+    artifactHold = holdFrames;
+}
+
+uint8_t artifactDetect(uint8_t channel, int16_t *sample) {
+    artifactState_t *state;
+    uint8_t wavelength;
+    int32_t step;
+    uint8_t detected = 0;
+
+    if (channel >= FNIR_CHANNELS) {
+        return (0);
+    }
+
+    state = &artifactState[channel];
+
+    if (artifactPrimed[channel>>3] & (1<<(channel & 0x07))) {
+        for (wavelength = 0; wavelength < 2; wavelength++) {
+            step = (int32_t) sample[wavelength] - state->previous[wavelength];
+
+            if (labs(step) > artifactThreshold) {
+                detected = 1;
+            }
+        }
+    } else {
+        artifactPrimed[channel>>3] |= (1<<(channel & 0x07));
+        state->hold = 0;
+    }
+
+    state->previous[0] = sample[0];
+    state->previous[1] = sample[1];
+
+    // Flag this frame, then hold flag for following frames
+    if (detected) {
+        state->hold = artifactHold + 1;
+    }
+
+    if (state->hold > 0) {
+        state->hold--;
+        return (1);
+    }
+
+    return (0);
+}
+
+#endif
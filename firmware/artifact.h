@@ -0,0 +1,69 @@
+/** @file artifact.h
+* @brief Streaming motion artifact detector
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional per-channel detector for the step and spike artifacts caused by
+* head movement, built in with \c FNIR_ARTIFACT_ENABLE. Each dark subtracted
+* sample is compared against the previous sample of the same channel and
+* wavelength; if the absolute difference exceeds the threshold for either
+* wavelength the channel is flagged, and the flag is held for a configurable
+* number of following frames so the whole disturbance is covered.
+*
+* The flag travels in the reported frame, letting a real time consumer gate
+* or hold samples without buffering a window on the host. Detector state is
+* 5 bytes per channel.
+*/
+
+#ifndef FNIR_ARTIFACT_THRESHOLD
+#define FNIR_ARTIFACT_THRESHOLD 2000 /**< Default sample to sample step, adc counts */
+#endif
+
+#ifndef FNIR_ARTIFACT_HOLD
+#define FNIR_ARTIFACT_HOLD 2 /**< Default frames flag is held after a detection */
+#endif
+
+/** Initializes artifact detector.
+*
+* Loads default threshold and hold time and leaves the detector disabled.
+*
+* @return Function does not return a value.
+*/
+extern void artifactInit(void);
+
+/** Enables or disables the detector.
+*
+* History is discarded on enable, the first frame after enabling is used to
+* prime the detector and is never flagged.
+*
+* @param enable Nonzero to run detector.
+*/
+extern void artifactEnable(uint8_t enable);
+
+/** Reports whether the detector is enabled.
+*
+* @return Nonzero when detector is running.
+*/
+extern uint8_t artifactIsEnabled(void);
+
+/** Sets detection threshold.
+*
+* @param threshold Absolute sample to sample change, in adc counts, above
+*                  which a sample is flagged.
+*/
+extern void artifactSetThreshold(uint16_t threshold);
+
+/** Sets flag hold time.
+*
+* @param holdFrames Number of frames a channel stays flagged after the last
+*                   sample exceeding the threshold.
+*/
+extern void artifactSetHold(uint8_t holdFrames);
+
+/** Runs detector over one channel's dark subtracted samples.
+*
+* @param channel Channel the samples were taken from.
+* @param sample  Dark subtracted 730nm and 850nm samples.
+* @return        Returns nonzero if the channel is currently flagged.
+*/
+extern uint8_t artifactDetect(uint8_t channel, int16_t *sample);
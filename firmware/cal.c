@@ -0,0 +1,152 @@
+/** @file cal.c
+* @brief EEPROM calibration store
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_CAL_ENABLE
+
+#define CAL_UNITY (1U<<CAL_FACTOR_SHIFT) /**< Factor of 1.0 */
+
+static calTable_t EEMEM calStored;
+static uint8_t EEMEM calStoredVersion;
+static uint16_t EEMEM calStoredCrc;
+
+static uint8_t calValid;
+static uint8_t calReceiving;
+static uint8_t calIdleTicks;
+static uint16_t calIndex; // Bytes received, table then 2 CRC bytes
+static uint16_t calRunningCrc;
+static uint16_t calReceivedCrc;
+
+void calInit(void) {
+    calReceiving = 0;
+    calValid = ((eeprom_read_byte(&calStoredVersion) == CAL_VERSION)
+                && (eeprom_read_word(&calStoredCrc) == calCrc()));
+}
+
+uint8_t calIsValid(void) {
+    return (calValid);
+}
+
+int16_t calDarkOffset(uint8_t detector) {
+    if (!calValid || (detector >= CAL_DETECTORS)) {
+        return (0);
+    }
+
+    return ((int16_t) eeprom_read_word((const uint16_t *) &calStored.darkOffset[detector]));
+}
+
+uint16_t calGainFactor(adcGain_t gain) {
+    if (!calValid || (gain >= CAL_GAINS)) {
+        return (CAL_UNITY);
+    }
+
+    return (eeprom_read_word(&calStored.gainFactor[gain]));
+}
+
+uint16_t calLedFactor(uint8_t source, uint8_t wavelength) {
+    if (!calValid || (source >= FNIR_SOURCES) || (wavelength > 1)) {
+        return (CAL_UNITY);
+    }
+
+    return (eeprom_read_word(&calStored.ledFactor[source][wavelength]));
+}
+
+uint8_t calTempCoefficients(uint8_t channel, int16_t *coefficient) {
+    if (!calValid || (channel >= FNIR_CHANNELS)) {
+        return (1);
+    }
+
+    eeprom_read_block(coefficient, &calStored.tempCoefficient[channel], 2 * sizeof(int16_t));
+
+    return (0);
+}
+
+int32_t calScale(int32_t value, uint16_t factor) {
+    // Limit keeps product within 32 bits
+    if (value > ADC_FULL_SCALE) {
+        value = ADC_FULL_SCALE;
+    } else if (value < -ADC_FULL_SCALE) {
+        value = -ADC_FULL_SCALE;
+    }
+
+    return ((value * (int32_t) factor + (1L<<(CAL_FACTOR_SHIFT-1)))>>CAL_FACTOR_SHIFT);
+}
+
+void calBeginReceive(void) {
+    eeprom_update_byte(&calStoredVersion, 0xFF);
+    calValid = 0;
+    calReceiving = 1;
+    calIdleTicks = 0;
+    calIndex = 0;
+    calRunningCrc = 0xFFFF;
+    calReceivedCrc = 0;
+}
+
+uint8_t calIsReceiving(void) {
+    return (calReceiving);
+}
+
+calReceive_t calReceive(uint8_t byte) {
+    if (!calReceiving) {
+        return (CAL_FAILED);
+    }
+
+    calIdleTicks = 0;
+
+    if (calIndex < sizeof(calTable_t)) {
+        eeprom_update_byte(((uint8_t *) &calStored) + calIndex, byte);
+        calRunningCrc = _crc16_update(calRunningCrc, byte);
+    } else {
+        calReceivedCrc |= ((uint16_t) byte)<<(8 * (calIndex - sizeof(calTable_t)));
+    }
+
+    if (++calIndex < (sizeof(calTable_t) + 2)) {
+        return (CAL_RECEIVING);
+    }
+
+    calReceiving = 0;
+
+    if (calReceivedCrc != calRunningCrc) {
+        return (CAL_FAILED);
+    }
+
+    eeprom_update_word(&calStoredCrc, calRunningCrc);
+    eeprom_update_byte(&calStoredVersion, CAL_VERSION);
+    calValid = 1;
+
+    return (CAL_STORED);
+}
+
+calReceive_t calTick(void) {
+    if (calReceiving && (++calIdleTicks >= CAL_TIMEOUT_TICKS)) {
+        calReceiving = 0;
+        return (CAL_FAILED);
+    }
+
+    return (CAL_RECEIVING);
+}
+
+uint8_t calReadByte(uint16_t offset) {
+    if (offset >= sizeof(calTable_t)) {
+        return (0);
+    }
+
+    return (eeprom_read_byte(((const uint8_t *) &calStored) + offset));
+}
+
+uint16_t calCrc(void) {
+    uint16_t crc = 0xFFFF;
+    uint16_t offset;
+
+    for (offset = 0; offset < sizeof(calTable_t); offset++) {
+        crc = _crc16_update(crc, calReadByte(offset));
+    }
+
+    return (crc);
+}
+
+#endif
@@ -0,0 +1,137 @@
+/** @file cal.h
+* @brief EEPROM calibration store
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional per device calibration table kept in EEPROM, built in with
+* \c FNIR_CAL_ENABLE, and applied on device so the host receives corrected
+* samples. The table holds:
+*
+* - an offset per detector (adc input) subtracted from every raw reading,
+* - a Q14 gain correction factor per \ref adcGain_t setting,
+* - a Q14 normalisation factor per LED source and wavelength applied to
+*   dark subtracted samples,
+* - Q8 temperature drift coefficients per channel and wavelength, loaded
+*   into the temperature module when it is built in.
+*
+* The table is read from EEPROM as samples are corrected rather than copied
+* into RAM. It is written in one binary transfer: the table bytes in memory
+* order followed by a CRC-16 of them, both little endian. A table whose
+* version or CRC does not match is not applied.
+*/
+
+#define CAL_DETECTORS (ADC_INPUTS * FNIR_ADC_CHIPS) /**< Detectors with an offset, one per unipolar adc input */
+#define CAL_GAINS 8 /**< Gain settings with a correction factor */
+#define CAL_FACTOR_SHIFT 14 /**< Fractional bits of correction factors, 1.0 is 16384 */
+#define CAL_VERSION 1 /**< Table format version */
+#define CAL_TIMEOUT_TICKS 4 /**< Calls to \ref calTick without data before a transfer is dropped */
+
+/** Calibration table
+*
+*/
+typedef struct {
+    int16_t darkOffset[CAL_DETECTORS]; /**< Offset per detector, adc LSBs */
+    uint16_t gainFactor[CAL_GAINS]; /**< Q14 correction per adcGain_t */
+    uint16_t ledFactor[FNIR_SOURCES][2]; /**< Q14 normalisation per source and wavelength */
+    int16_t tempCoefficient[FNIR_CHANNELS][2]; /**< Q8 drift per channel and wavelength, see temp.h */
+} calTable_t;
+
+/** Result of receiving one byte of a table transfer.
+*
+*/
+typedef enum {
+    CAL_RECEIVING, /**< More bytes expected */
+    CAL_STORED, /**< Table received with a good CRC and committed */
+    CAL_FAILED /**< CRC mismatch or transfer dropped, table left invalid */
+} calReceive_t;
+
+/** Checks stored table.
+*
+* @return Function does not return a value.
+*/
+extern void calInit(void);
+
+/** Reports whether a valid table is stored.
+*
+* @return Nonzero when the table is applied.
+*/
+extern uint8_t calIsValid(void);
+
+/** Returns offset of a detector.
+*
+* @param detector Detector, adc index times ADC_INPUTS plus input.
+* @return         Offset in adc LSBs, 0 without a valid table.
+*/
+extern int16_t calDarkOffset(uint8_t detector);
+
+/** Returns gain correction factor.
+*
+* @param gain Gain setting.
+* @return     Q14 factor, 1.0 without a valid table.
+*/
+extern uint16_t calGainFactor(adcGain_t gain);
+
+/** Returns LED normalisation factor.
+*
+* @param source     LED source.
+* @param wavelength 0 for 730nm, 1 for 850nm.
+* @return           Q14 factor, 1.0 without a valid table.
+*/
+extern uint16_t calLedFactor(uint8_t source, uint8_t wavelength);
+
+/** Reads temperature drift coefficients of a channel.
+*
+* @param channel     Channel.
+* @param coefficient Receives 730nm and 850nm Q8 coefficients.
+* @return            Returns 0 on success, 1 without a valid table.
+*/
+extern uint8_t calTempCoefficients(uint8_t channel, int16_t *coefficient);
+
+/** Scales a value by a correction factor.
+*
+* @param value  Value, limited to +/- ADC_FULL_SCALE before scaling.
+* @param factor Q14 factor.
+* @return       Scaled value, rounded.
+*/
+extern int32_t calScale(int32_t value, uint16_t factor);
+
+/** Starts receiving a table.
+*
+* The stored table is invalid until the transfer completes with a good CRC.
+*/
+extern void calBeginReceive(void);
+
+/** Reports whether a table transfer is in progress.
+*
+* @return Nonzero while bytes are being received.
+*/
+extern uint8_t calIsReceiving(void);
+
+/** Stores one byte of a table transfer.
+*
+* @param byte Next byte from host.
+* @return     State of transfer after this byte.
+*/
+extern calReceive_t calReceive(uint8_t byte);
+
+/** Counts time without transfer data.
+*
+* Call periodically, a transfer is dropped after \ref CAL_TIMEOUT_TICKS calls
+* without a byte.
+*
+* @return Returns \c CAL_FAILED if a transfer was dropped, \c CAL_RECEIVING otherwise.
+*/
+extern calReceive_t calTick(void);
+
+/** Returns one byte of the stored table.
+*
+* @param offset Byte offset into table, up to sizeof(calTable_t) - 1.
+* @return       Table byte.
+*/
+extern uint8_t calReadByte(uint16_t offset);
+
+/** Returns CRC of the stored table.
+*
+* @return CRC-16 over table bytes.
+*/
+extern uint16_t calCrc(void);
@@ -0,0 +1,101 @@
+/** @file dark.c
+* @brief Adaptive dark current tracking
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_DARK_TRACK_ENABLE
+
+#define DARK_FRACTION_BITS 8 /**< Fractional bits of dark estimates */
+
+static int32_t darkLevel[DARK_DETECTORS]; // Q8 estimates
+static uint16_t darkSeeded; // One bit per detector, set once estimate is valid
+static uint8_t darkInterval;
+static uint8_t darkPhase;
+static uint8_t darkShift;
+static uint8_t darkEnabled;
+
+void darkInit(void) {
+    darkInterval = FNIR_DARK_INTERVAL;
+    darkShift = FNIR_DARK_SHIFT;
+    darkEnabled = 0;
+    darkInvalidate();
+}
+
+void darkEnable(uint8_t enable) {
+    if (enable && !darkEnabled) {
+        darkInvalidate();
+    }
+
+    darkEnabled = enable;
+}
+
+uint8_t darkIsEnabled(void) {
+    return (darkEnabled);
+}
+
+void darkSetInterval(uint8_t frames) {
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    darkInterval = frames;
+    darkPhase = 0;
+}
+
+void darkSetShift(uint8_t shift) {
+    if (shift > 7) {
+        shift = 7;
+    }
+
+    darkShift = shift;
+}
+
+void darkInvalidate(void) {
+    darkSeeded = 0;
+    darkPhase = 0;
+}
+
+uint8_t darkRefreshDue(uint8_t channel, uint8_t detector) {
+    // Advance refresh phase once per frame
+    if (channel == 0) {
+        if (++darkPhase >= darkInterval) {
+            darkPhase = 0;
+        }
+    }
+
+    if (detector >= DARK_DETECTORS) {
+        return (1);
+    }
+
+    return ((darkPhase == 0) || !(darkSeeded & (1U<<detector)));
+}
+
+void darkUpdate(uint8_t detector, int32_t dark) {
+    int32_t measured;
+
+    if (detector >= DARK_DETECTORS) {
+        return;
+    }
+
+    measured = dark<<DARK_FRACTION_BITS;
+
+    if (darkSeeded & (1U<<detector)) {
+        darkLevel[detector] += (measured - darkLevel[detector])>>darkShift;
+    } else {
+        darkLevel[detector] = measured;
+        darkSeeded |= (1U<<detector);
+    }
+}
+
+int32_t darkEstimate(uint8_t detector) {
+    if (detector >= DARK_DETECTORS) {
+        return (0);
+    }
+
+    return ((darkLevel[detector] + (1L<<(DARK_FRACTION_BITS-1)))>>DARK_FRACTION_BITS);
+}
+
+#endif
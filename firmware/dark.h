@@ -0,0 +1,94 @@
+/** @file dark.h
+* @brief Adaptive dark current tracking
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional replacement for the dark conversion taken after every channel,
+* built in with \c FNIR_DARK_TRACK_ENABLE. Dark levels drift slowly, so
+* instead of spending a full conversion on them each frame an exponentially
+* averaged estimate is kept per detector (adc input) and subtracted on device.
+* The dark conversion is only taken on every Nth frame, or on the next frame
+* after \ref darkInvalidate is called because detector gain or temperature has
+* changed.
+*
+* With an interval of N frames dark conversions drop from one in three to
+* one in 2N+1 conversions, while slow drift is still followed. Estimates are
+* held in Q8, 4 bytes per detector.
+*/
+
+#define DARK_DETECTORS 16 /**< Detectors tracked, one per unipolar adc input */
+
+#ifndef FNIR_DARK_INTERVAL
+#define FNIR_DARK_INTERVAL 16 /**< Default frames between dark refreshes */
+#endif
+
+#ifndef FNIR_DARK_SHIFT
+#define FNIR_DARK_SHIFT 2 /**< Default averaging shift, each refresh moves estimate 1/2^shift of the way */
+#endif
+
+/** Initializes dark tracking.
+*
+* Loads default interval and averaging and leaves tracking disabled.
+*
+* @return Function does not return a value.
+*/
+extern void darkInit(void);
+
+/** Enables or disables dark tracking.
+*
+* Estimates are reseeded from a fresh measurement when tracking is enabled.
+*
+* @param enable Nonzero to track dark level, zero to measure it every frame.
+*/
+extern void darkEnable(uint8_t enable);
+
+/** Reports whether dark tracking is enabled.
+*
+* @return Nonzero when dark level is being tracked.
+*/
+extern uint8_t darkIsEnabled(void);
+
+/** Sets number of frames between dark refreshes.
+*
+* @param frames Refresh interval, 1 refreshes every frame. Zero is treated as 1.
+*/
+extern void darkSetInterval(uint8_t frames);
+
+/** Sets exponential averaging weight.
+*
+* @param shift Each refresh moves the estimate 1/2^shift of the way towards
+*              the new measurement, 0 to 7.
+*/
+extern void darkSetShift(uint8_t shift);
+
+/** Discards all estimates.
+*
+* Call when detector gain or temperature changes. Every detector is measured
+* again in the next frame and its estimate reseeded from that measurement.
+*/
+extern void darkInvalidate(void);
+
+/** Decides whether a channel needs a dark conversion this frame.
+*
+* Must be called once per channel per frame, in scan order, so the refresh
+* phase advances each time channel 0 is processed.
+*
+* @param channel  Channel being scanned.
+* @param detector Detector (adc input) of the channel.
+* @return         Returns nonzero if a dark conversion should be taken.
+*/
+extern uint8_t darkRefreshDue(uint8_t channel, uint8_t detector);
+
+/** Folds a dark measurement into a detector's estimate.
+*
+* @param detector Detector (adc input) measured.
+* @param dark     Measured dark level.
+*/
+extern void darkUpdate(uint8_t detector, int32_t dark);
+
+/** Returns current dark estimate of a detector.
+*
+* @param detector Detector (adc input).
+* @return         Estimated dark level, rounded to whole adc counts.
+*/
+extern int32_t darkEstimate(uint8_t detector);
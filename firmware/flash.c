@@ -0,0 +1,350 @@
+/** @file flash.c
+* @brief Dataflash session recording
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_FLASH_ENABLE
+
+#define FLASH_COMMAND_BYTES 4 /**< Opcode and 24 bit address */
+#define FLASH_READ_DUMMY_BYTES 4 /**< Don't care bytes after a main memory page read command */
+#define FLASH_READ_CHUNK 32 /**< Bytes read per transfer, bounds stack use */
+
+static flashFrame_t flashQueue[FNIR_FLASH_QUEUE_FRAMES];
+static uint8_t flashQueueHead;
+static uint8_t flashQueueCount;
+static uint8_t flashRecording;
+static uint8_t flashStopping;
+static uint8_t flashBuffer; // Chip buffer being filled, 0 or 1
+static uint16_t flashOffset; // Next free byte of chip buffer
+static uint16_t flashPageFrames; // Frames in chip buffer
+static uint16_t flashPage; // Page the chip buffer will be programmed into
+static uint16_t flashSessionNumber;
+static uint16_t flashSequence;
+static uint32_t flashFrameCount;
+static uint16_t flashDropCount;
+
+static void flashTransfer(uint8_t *buffer, uint8_t length);
+static void flashCommand(uint8_t *buffer, uint8_t opcode, uint16_t page, uint16_t offset);
+static uint8_t flashStatus(void);
+static uint8_t flashWaitReady(void);
+static uint16_t flashPageSession(uint16_t page);
+static uint8_t flashProgram(void);
+
+void flashInit(void) {
+    // Deselected is high
+    BOARD_FLASH_CS_PORT |= FNIR_FLASH_CS_PIN;
+    BOARD_FLASH_CS_DDR |= FNIR_FLASH_CS_PIN;
+
+    flashRecording = 0;
+    flashStopping = 0;
+    flashQueueCount = 0;
+    flashPage = 0;
+    flashSessionNumber = 0;
+    flashFrameCount = 0;
+    flashDropCount = 0;
+}
+
+uint8_t flashStart(void) {
+    if (flashWaitReady()) {
+        return (1);
+    }
+
+    // Next session number, never the erased pattern
+    flashSessionNumber = flashPageSession(0) + 1;
+
+    if (flashSessionNumber == FLASH_ERASED_SESSION) {
+        flashSessionNumber = 0;
+    }
+
+    flashQueueHead = 0;
+    flashQueueCount = 0;
+    flashBuffer = 0;
+    flashOffset = FLASH_HEADER_BYTES;
+    flashPageFrames = 0;
+    flashPage = 0;
+    flashSequence = 0;
+    flashFrameCount = 0;
+    flashDropCount = 0;
+    flashStopping = 0;
+    flashRecording = 1;
+
+    return (0);
+}
+
+void flashStop(void) {
+    if (flashRecording) {
+        flashStopping = 1;
+    }
+}
+
+uint8_t flashIsRecording(void) {
+    return (flashRecording);
+}
+
+void flashLog(uint8_t channel, uint8_t flags, int16_t *result) {
+    flashFrame_t *frame;
+
+    if (!flashRecording || flashStopping) {
+        return;
+    }
+
+    if (flashQueueCount == FNIR_FLASH_QUEUE_FRAMES) {
+        flashDropCount++;
+        return;
+    }
+
+    frame = &flashQueue[(flashQueueHead + flashQueueCount) % FNIR_FLASH_QUEUE_FRAMES];
+    frame->sequence = flashSequence++;
+    frame->channel = channel;
+    frame->flags = flags;
+    frame->result[0] = result[0];
+    frame->result[1] = result[1];
+    frame->result[2] = result[2];
+
+    flashQueueCount++;
+    flashFrameCount++;
+}
+
+void flashService(void) {
+    uint8_t transfer[FLASH_COMMAND_BYTES + FLASH_FRAME_BYTES];
+
+    if (!flashRecording || adcIsWaiting()) {
+        return;
+    }
+
+    while (flashQueueCount) {
+        if ((flashOffset + FLASH_FRAME_BYTES) > FLASH_PAGE_SIZE) {
+            if (flashProgram()) {
+                return; // Other buffer still programming, frames wait in queue
+            }
+
+            if (!flashRecording) {
+                return; // Array full
+            }
+        }
+
+        flashCommand(transfer, flashBuffer ? DF_CMD_BUFF2WRITE : DF_CMD_BUFF1WRITE, 0, flashOffset);
+        memcpy(&transfer[FLASH_COMMAND_BYTES], &flashQueue[flashQueueHead], FLASH_FRAME_BYTES);
+        flashTransfer(transfer, sizeof(transfer));
+
+        flashOffset += FLASH_FRAME_BYTES;
+        flashPageFrames++;
+        flashQueueHead = (flashQueueHead + 1) % FNIR_FLASH_QUEUE_FRAMES;
+        flashQueueCount--;
+    }
+
+    if (flashStopping) {
+        if ((flashPageFrames > 0) && flashProgram()) {
+            return;
+        }
+
+        flashStopping = 0;
+        flashRecording = 0;
+    }
+}
+
+uint16_t flashRecordedPages(void) {
+    uint16_t session;
+    uint16_t low;
+    uint16_t high;
+    uint16_t middle;
+
+    if (flashWaitReady()) {
+        return (0);
+    }
+
+    session = flashPageSession(0);
+
+    if (session == FLASH_ERASED_SESSION) {
+        return (0);
+    }
+
+    // Pages of the last recording form a prefix, low is in it and high is not
+    low = 0;
+    high = FLASH_PAGES;
+
+    while ((high - low) > 1) {
+        middle = low + ((high - low)>>1);
+
+        if (flashPageSession(middle) == session) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return (high);
+}
+
+void flashRead(uint16_t page, uint16_t offset, uint8_t *buffer, uint8_t length) {
+    uint8_t transfer[FLASH_COMMAND_BYTES + FLASH_READ_DUMMY_BYTES + FLASH_READ_CHUNK];
+    uint8_t chunk;
+
+    if (offset >= FLASH_PAGE_SIZE) {
+        return;
+    }
+
+    // Page read wraps within the page, stop at its end
+    if (length > (FLASH_PAGE_SIZE - offset)) {
+        length = FLASH_PAGE_SIZE - offset;
+    }
+
+    while (length) {
+        chunk = (length > FLASH_READ_CHUNK) ? FLASH_READ_CHUNK : length;
+
+        memset(transfer, 0x00, sizeof(transfer));
+        flashCommand(transfer, DF_CMD_MAINMEMPAGEREAD, page, offset);
+        flashTransfer(transfer, FLASH_COMMAND_BYTES + FLASH_READ_DUMMY_BYTES + chunk);
+        memcpy(buffer, &transfer[FLASH_COMMAND_BYTES + FLASH_READ_DUMMY_BYTES], chunk);
+
+        buffer += chunk;
+        offset += chunk;
+        length -= chunk;
+    }
+}
+
+uint16_t flashSession(void) {
+    return (flashSessionNumber);
+}
+
+uint16_t flashPagesWritten(void) {
+    return (flashPage);
+}
+
+uint32_t flashFrames(void) {
+    return (flashFrameCount);
+}
+
+uint16_t flashDropped(void) {
+    return (flashDropCount);
+}
+
+/** Runs one transfer with the dataflash.
+*
+* Received bytes overwrite sent ones in place.
+*
+* @param buffer Bytes to send, replaced by bytes received.
+* @param length Bytes to transfer.
+*/
+static void flashTransfer(uint8_t *buffer, uint8_t length) {
+    spiTransaction_t transaction;
+
+    transaction.txBuffer = buffer;
+    transaction.rxBuffer = buffer;
+    transaction.length = length;
+    transaction.csPort = &BOARD_FLASH_CS_PORT;
+    transaction.csMask = FNIR_FLASH_CS_PIN;
+    transaction.flags = SPI_MSB_FIRST;
+
+    spiTransfer(&transaction);
+}
+
+/** Builds opcode and address at start of a transfer.
+*
+* @param buffer Transfer buffer, at least \ref FLASH_COMMAND_BYTES long.
+* @param opcode Command opcode.
+* @param page   Page addressed, 0 for buffer commands.
+* @param offset Byte within page or buffer.
+*/
+static void flashCommand(uint8_t *buffer, uint8_t opcode, uint16_t page, uint16_t offset) {
+    uint32_t address;
+
+    address = ((uint32_t) page<<FLASH_PAGE_SHIFT) | offset;
+
+    buffer[0] = opcode;
+    buffer[1] = (uint8_t) (address>>16);
+    buffer[2] = (uint8_t) (address>>8);
+    buffer[3] = (uint8_t) address;
+}
+
+/** Reads status register.
+*
+* @return Status byte, \c DF_STATUS_READY set when no program is running.
+*/
+static uint8_t flashStatus(void) {
+    uint8_t transfer[2];
+
+    transfer[0] = DF_CMD_GETSTATUS;
+    transfer[1] = 0x00;
+    flashTransfer(transfer, sizeof(transfer));
+
+    return (transfer[1]);
+}
+
+/** Waits for a running page program to finish.
+*
+* Only needed before reading the array, as a recording just stopped may
+* still be programming its last page.
+*
+* @return Returns 0 when ready, 1 if no dataflash of the expected type answers.
+*/
+static uint8_t flashWaitReady(void) {
+    uint8_t status;
+
+    do {
+        status = flashStatus();
+
+        if ((status & FLASH_STATUS_MASK) != FLASH_STATUS_ID) {
+            return (1);
+        }
+    } while (!(status & DF_STATUS_READY));
+
+    return (0);
+}
+
+/** Reads session number from a page header.
+*
+* @param page Page to read.
+* @return Session number, \ref FLASH_ERASED_SESSION if the page is erased.
+*/
+static uint16_t flashPageSession(uint16_t page) {
+    uint16_t session;
+
+    flashRead(page, 0, (uint8_t *) &session, sizeof(session));
+
+    return (session);
+}
+
+/** Programs the filled chip buffer into its page and switches buffers.
+*
+* Stops recording once the last page of the array is programmed.
+*
+* @return Returns 0 on success, 1 if the other buffer's page is still being
+*         programmed.
+*/
+static uint8_t flashProgram(void) {
+    uint8_t transfer[FLASH_COMMAND_BYTES + FLASH_HEADER_BYTES];
+
+    if (!(flashStatus() & DF_STATUS_READY)) {
+        return (1);
+    }
+
+    // Header goes in last, once the frame count is known
+    flashCommand(transfer, flashBuffer ? DF_CMD_BUFF2WRITE : DF_CMD_BUFF1WRITE, 0, 0);
+    transfer[4] = (uint8_t) flashSessionNumber;
+    transfer[5] = (uint8_t) (flashSessionNumber>>8);
+    transfer[6] = (uint8_t) flashPageFrames;
+    transfer[7] = (uint8_t) (flashPageFrames>>8);
+    flashTransfer(transfer, sizeof(transfer));
+
+    flashCommand(transfer, flashBuffer ? DF_CMD_BUFF2TOMAINMEMWITHERASE : DF_CMD_BUFF1TOMAINMEMWITHERASE, flashPage, 0);
+    flashTransfer(transfer, FLASH_COMMAND_BYTES);
+
+    flashBuffer ^= 1;
+    flashOffset = FLASH_HEADER_BYTES;
+    flashPageFrames = 0;
+
+    if (++flashPage >= FLASH_PAGES) {
+        flashRecording = 0;
+        flashStopping = 0;
+        flashDropCount += flashQueueCount;
+        flashQueueCount = 0;
+    }
+
+    return (0);
+}
+
+#endif
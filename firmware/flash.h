@@ -0,0 +1,163 @@
+/** @file flash.h
+* @brief Dataflash session recording
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional untethered recording to an Atmel AT45DB dataflash on the SPI bus,
+* built in with \c FNIR_FLASH_ENABLE. An AT45DB642D is assumed, or an
+* AT45DB321C with \c FNIR_FLASH_AT45DB321C; command codes come from the LUFA
+* headers for each part.
+*
+* Every data line is also stored as a 10 byte binary frame. Frames are held
+* in a short RAM queue and copied into one of the chip's two SRAM page
+* buffers whenever the SPI bus is free, which is while the adc converts
+* deselected, since a selected LTC2494 would take the clock as a read of its
+* result. Once a buffer is full it is programmed into its page with built in
+* erase, which runs inside the chip, and frames go on into the other
+* buffer. A page program takes at most 40ms while a page holds 105 frames
+* (52 on the AT45DB321C), filled in 6 seconds at the very least by 4 adcs at
+* double speed, so programming never holds up acquisition. A frame is only
+* dropped and counted if the queue overflows or the array is full.
+*
+* A recording always starts at page 0. Every page begins with a 4 byte
+* header holding the recording's session number, one more than the last
+* recording's, and the number of frames in the page. The recorded length is
+* found after power up by a binary search for the first page of another
+* session, so a recording ended by pulling the battery keeps every full
+* page.
+*/
+
+#ifndef FNIR_FLASH_CS_PIN
+#define FNIR_FLASH_CS_PIN BOARD_FLASH_CS_PIN /**< Default chip select pin mask on \c BOARD_FLASH_CS_PORT */
+#endif
+
+#ifndef FNIR_FLASH_QUEUE_FRAMES
+#define FNIR_FLASH_QUEUE_FRAMES 4 /**< Frames held until the bus is free, 10 bytes each */
+#endif
+
+#ifdef FNIR_FLASH_AT45DB321C
+#define FLASH_PAGE_SIZE 528 /**< Bytes per page */
+#define FLASH_PAGE_SHIFT 10 /**< Page number position in a 24 bit address */
+#define FLASH_PAGES 8192 /**< Pages in the array */
+#define FLASH_STATUS_MASK 0x3C /**< Status bits checked when recording starts */
+#define FLASH_STATUS_ID 0x34 /**< 32Mbit density code */
+#else
+#define FLASH_PAGE_SIZE 1056 /**< Bytes per page, standard page size */
+#define FLASH_PAGE_SHIFT 11 /**< Page number position in a 24 bit address */
+#define FLASH_PAGES 8192 /**< Pages in the array */
+#define FLASH_STATUS_MASK 0x3D /**< Status bits checked when recording starts */
+#define FLASH_STATUS_ID 0x3C /**< 64Mbit density code, standard page size */
+#endif
+
+#define FLASH_HEADER_BYTES 4 /**< Session and frame count ahead of a page's frames */
+#define FLASH_FRAME_BYTES 10 /**< Bytes per stored frame */
+#define FLASH_ERASED_SESSION 0xFFFF /**< Session read from an erased page */
+
+/** Data line as stored in dataflash, little endian.
+*
+*/
+typedef struct __attribute__((packed)) {
+    uint16_t sequence; /**< Frame number within the recording */
+    uint8_t channel; /**< Channel measured */
+    uint8_t flags; /**< RESULT_FLAG_* bits */
+    int16_t result[3]; /**< 730nm, 850nm and dark results, clamped ones flagged over or under range */
+} flashFrame_t;
+
+/** Initializes dataflash recording.
+*
+* Drives the chip select pin as an output with the dataflash deselected and
+* leaves recording stopped.
+*
+* @return Function does not return a value.
+*/
+extern void flashInit(void);
+
+/** Starts a new recording at page 0.
+*
+* Must only be called while the scan is stopped, as it talks to the chip
+* straight away.
+*
+* @return Returns 0 on success, 1 if no dataflash of the expected type answers.
+*/
+extern uint8_t flashStart(void);
+
+/** Ends the recording.
+*
+* The partly filled page is programmed by a later \ref flashService, after
+* which \ref flashIsRecording reads zero.
+*
+* @return Function does not return a value.
+*/
+extern void flashStop(void);
+
+/** Reports whether a recording is running or being flushed.
+*
+* @return Nonzero until the last page of a recording has been programmed.
+*/
+extern uint8_t flashIsRecording(void);
+
+/** Queues one data line for recording.
+*
+* Never blocks, the frame is dropped and counted if the queue is full.
+* Ignored while not recording.
+*
+* @param channel Channel measured.
+* @param flags   RESULT_FLAG_* bits.
+* @param result  730nm, 850nm and dark results.
+*/
+extern void flashLog(uint8_t channel, uint8_t flags, int16_t *result);
+
+/** Moves queued frames into the dataflash.
+*
+* Returns straight away while an adc is held selected. Call whenever the
+* bus may be free; each frame takes 14 bytes on the bus.
+*
+* @return Function does not return a value.
+*/
+extern void flashService(void);
+
+/** Counts pages of the last recording.
+*
+* Binary searches page headers, must only be called while the scan is
+* stopped.
+*
+* @return Pages written by the last recording, 0 if there is none or no
+*         dataflash answers.
+*/
+extern uint16_t flashRecordedPages(void);
+
+/** Reads bytes from a page.
+*
+* Must only be called while the scan is stopped, once \ref flashRecordedPages
+* has found a dataflash.
+*
+* @param page   Page to read.
+* @param offset First byte within the page.
+* @param buffer Buffer for the bytes.
+* @param length Bytes to read, the read stops at the end of the page.
+*/
+extern void flashRead(uint16_t page, uint16_t offset, uint8_t *buffer, uint8_t length);
+
+/** Returns session number of the running or last started recording.
+*
+* @return Session number.
+*/
+extern uint16_t flashSession(void);
+
+/** Returns pages programmed by the running or last started recording.
+*
+* @return Pages programmed.
+*/
+extern uint16_t flashPagesWritten(void);
+
+/** Returns frames queued by the running or last started recording.
+*
+* @return Frames recorded.
+*/
+extern uint32_t flashFrames(void);
+
+/** Returns frames dropped by the running or last started recording.
+*
+* @return Frames dropped because the queue was full or the array was full.
+*/
+extern uint16_t flashDropped(void);
@@ -0,0 +1,130 @@
+/** @file iir.c
+* @brief Fixed-point biquad filter bank
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_IIR_ENABLE
+
+/** Direct form I history of one biquad section, Q15. */
+typedef struct {
+    int16_t x1; /**< Previous input */
+    int16_t x2; /**< Second previous input */
+    int16_t y1; /**< Previous output */
+    int16_t y2; /**< Second previous output */
+} iirState_t;
+
+static iirCoefficients_t iirCoefficients[FNIR_IIR_SECTIONS];
+static iirState_t iirState[FNIR_IIR_CHANNELS][IIR_WAVELENGTHS][FNIR_IIR_SECTIONS];
+static uint8_t iirEnabled;
+static uint8_t iirDecimation;
+static uint8_t iirDecimationPhase;
+
+static int16_t iirSection(iirCoefficients_t *coefficients, iirState_t *state, int16_t x);
+
+void iirInit(void) {
+    uint8_t section;
+
+    for (section = 0; section < FNIR_IIR_SECTIONS; section++) {
+        iirCoefficients[section].b0 = (1<<IIR_COEFF_SHIFT); // Unity gain
+        iirCoefficients[section].b1 = 0;
+        iirCoefficients[section].b2 = 0;
+        iirCoefficients[section].a1 = 0;
+        iirCoefficients[section].a2 = 0;
+    }
+
+    memset(iirState, 0, sizeof(iirState));
+    iirEnabled = 0;
+    iirDecimation = 1;
+    iirDecimationPhase = 0;
+}
+
+void iirEnable(uint8_t enable) {
+    if (enable && !iirEnabled) {
+        memset(iirState, 0, sizeof(iirState));
+        iirDecimationPhase = 0;
+    }
+
+    iirEnabled = enable;
+}
+
+uint8_t iirIsEnabled(void) {
+    return (iirEnabled);
+}
+
+uint8_t iirSetCoefficients(uint8_t section, iirCoefficients_t *coefficients) {
+    if (section >= FNIR_IIR_SECTIONS) {
+        return (1);
+    }
+
+    iirCoefficients[section] = *coefficients;
+
+    return (0);
+}
+
+void iirSetDecimation(uint8_t factor) {
+    if (factor == 0) {
+        factor = 1;
+    }
+
+    iirDecimation = factor;
+    iirDecimationPhase = 0;
+}
+
+uint8_t iirProcess(uint8_t channel, int16_t *sample) {
+    uint8_t wavelength;
+    uint8_t section;
+
+    // Advance decimation once per frame
+    if (channel == 0) {
+        if (++iirDecimationPhase >= iirDecimation) {
+            iirDecimationPhase = 0;
+        }
+    }
+
+    if (channel < FNIR_IIR_CHANNELS) {
+        for (wavelength = 0; wavelength < IIR_WAVELENGTHS; wavelength++) {
+            for (section = 0; section < FNIR_IIR_SECTIONS; section++) {
+                sample[wavelength] = iirSection(&iirCoefficients[section],
+                                                &iirState[channel][wavelength][section],
+                                                sample[wavelength]);
+            }
+        }
+    }
+
+    return (iirDecimationPhase == 0);
+}
+
+/** Runs one sample through one biquad section.
+*
+* @param coefficients Q2.14 section coefficients.
+* @param state        Section history, updated with this sample.
+* @param x            Q15 input sample.
+* @return             Q15 output sample, saturated.
+*/
+static int16_t iirSection(iirCoefficients_t *coefficients, iirState_t *state, int16_t x) {
+    int32_t accumulator;
+    int16_t y;
+
+    accumulator = (1L<<(IIR_COEFF_SHIFT-1)); // Round to nearest
+    accumulator += (int32_t) coefficients->b0 * x;
+    accumulator += (int32_t) coefficients->b1 * state->x1;
+    accumulator += (int32_t) coefficients->b2 * state->x2;
+    accumulator -= (int32_t) coefficients->a1 * state->y1;
+    accumulator -= (int32_t) coefficients->a2 * state->y2;
+    accumulator >>= IIR_COEFF_SHIFT;
+
+    // Saturate rather than wrap on overflow
+    y = q15Saturate(accumulator);
+
+    state->x2 = state->x1;
+    state->x1 = x;
+    state->y2 = state->y1;
+    state->y1 = y;
+
+    return (y);
+}
+
+#endif
@@ -0,0 +1,129 @@
+/** @file iir.h
+* @brief Fixed-point biquad filter bank
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional filter stage run on the dark subtracted 730nm and 850nm intensity
+* of each channel, built in with \c FNIR_IIR_ENABLE. Every channel/wavelength
+* pair runs its own cascade of \c FNIR_IIR_SECTIONS direct form I biquads,
+* all sharing one set of coefficients per section. Samples are dark
+* subtracted adc counts taken as Q15, so 1.0 is 32768 counts, the adc's
+* positive full scale of 0.5 VREF; a lit minus dark difference beyond that is
+* clamped and flagged over or under range before filtering. Coefficients are
+* Q2.14 so the feedback terms may reach +/-2, and each section accumulates in
+* 32 bits before rounding back to Q15.
+*
+* Coefficients are uploaded by the host, so the same image can run a low pass
+* to strip cardiac and Mayer wave components or a band pass for a task design.
+* After filtering the output may be decimated by a whole number of frames,
+* reducing the USB bandwidth each channel needs.
+*
+* Each section of each stream holds four Q15 history words (8 bytes). Filter
+* RAM for a configuration is therefore:
+*
+* @code
+* IIR_RAM_BYTES = FNIR_IIR_CHANNELS * 2 * FNIR_IIR_SECTIONS * 8   // history
+*               + FNIR_IIR_SECTIONS * 10                          // coefficients
+*               + 3                                               // control
+* @endcode
+*
+* | Channels | Sections | RAM (bytes) |
+* |---------:|---------:|------------:|
+* |       16 |        1 |         269 |
+* |        8 |        2 |         279 |
+* |        8 |        1 |         141 |
+* |        4 |        2 |         151 |
+* |        4 |        3 |         225 |
+*
+* The build fails if the configuration exceeds \c FNIR_IIR_RAM_BUDGET, and
+* the figure for the running image can be read back from the host.
+*/
+
+#ifndef FNIR_IIR_SECTIONS
+#define FNIR_IIR_SECTIONS 1 /**< Biquad sections cascaded per stream */
+#endif
+
+#ifndef FNIR_IIR_CHANNELS
+#define FNIR_IIR_CHANNELS 16 /**< Channels filtered, starting at channel 0 */
+#endif
+
+#ifndef FNIR_IIR_RAM_BUDGET
+#define FNIR_IIR_RAM_BUDGET (288*BOARD_RAM_SCALE) /**< Bytes of SRAM the filter bank may use */
+#endif
+
+#define IIR_WAVELENGTHS 2 /**< 730nm and 850nm streams per channel */
+#define IIR_COEFF_SHIFT 14 /**< Fractional bits in a Q2.14 coefficient */
+
+/** Total SRAM used by the filter bank in bytes. */
+#define IIR_RAM_BYTES ((FNIR_IIR_CHANNELS * IIR_WAVELENGTHS * FNIR_IIR_SECTIONS * 8) \
+                       + (FNIR_IIR_SECTIONS * 10) + 3)
+
+#if defined(FNIR_IIR_ENABLE) && (IIR_RAM_BYTES > FNIR_IIR_RAM_BUDGET)
+#error Filter bank configuration exceeds FNIR_IIR_RAM_BUDGET, reduce FNIR_IIR_CHANNELS or FNIR_IIR_SECTIONS
+#endif
+
+/** Coefficients of one biquad section, Q2.14.
+*
+* Implements y = b0*x + b1*x[-1] + b2*x[-2] - a1*y[-1] - a2*y[-2], with a0
+* normalized to 1.
+*/
+typedef struct {
+    int16_t b0; /**< Feedforward coefficient of current input */
+    int16_t b1; /**< Feedforward coefficient of previous input */
+    int16_t b2; /**< Feedforward coefficient of second previous input */
+    int16_t a1; /**< Feedback coefficient of previous output */
+    int16_t a2; /**< Feedback coefficient of second previous output */
+} iirCoefficients_t;
+
+/** Initializes filter bank.
+*
+* Loads pass-through coefficients into every section, clears filter history,
+* sets decimation to 1 and leaves the filter stage disabled.
+*
+* @return Function does not return a value.
+*/
+extern void iirInit(void);
+
+/** Enables or disables the filter stage.
+*
+* Filter history is cleared whenever the stage is enabled so stale samples
+* are not mixed into a new run.
+*
+* @param enable Nonzero to filter results, zero to pass raw results through.
+*/
+extern void iirEnable(uint8_t enable);
+
+/** Reports whether the filter stage is enabled.
+*
+* @return Nonzero when results are being filtered.
+*/
+extern uint8_t iirIsEnabled(void);
+
+/** Loads coefficients of one biquad section.
+*
+* @param section      Section index, 0 to \c FNIR_IIR_SECTIONS - 1.
+* @param coefficients Q2.14 coefficients for the section.
+* @return             Returns 0 on success, 1 if section is out of range.
+*/
+extern uint8_t iirSetCoefficients(uint8_t section, iirCoefficients_t *coefficients);
+
+/** Sets output decimation factor.
+*
+* @param factor Number of frames combined into one reported frame, 1 reports
+*               every frame. Zero is treated as 1.
+*/
+extern void iirSetDecimation(uint8_t factor);
+
+/** Filters both wavelengths of one channel in place.
+*
+* Must be called once per channel per frame, in scan order, so the
+* decimation phase advances each time channel 0 is processed. Channels at or
+* above \c FNIR_IIR_CHANNELS are passed through unfiltered.
+*
+* @param channel Channel the samples were taken from.
+* @param sample  Dark subtracted Q15 730nm and 850nm samples, replaced by the
+*                filter output.
+* @return        Returns nonzero if this frame should be reported, zero if it
+*                is dropped by decimation.
+*/
+extern uint8_t iirProcess(uint8_t channel, int16_t *sample);
@@ -2,16 +2,47 @@
 #include <avr/io.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 #include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include <avr/eeprom.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 
 // Custom project specific include files
+#include "montage.h" // Generated from $(MONTAGE) by the makefile
+#include "Config/FnirConfig.h"
+#include "Config/FnirBoard.h"
+#include "q15.h"
+#include "sched.h"
 #include "spi.h"
+#include "uspi.h"
 #include "2494_adc.h"
+#include "iir.h"
+#include "artifact.h"
+#include "stats.h"
+#include "dark.h"
+#include "temp.h"
+#include "settle.h"
+#include "led.h"
+#include "speed.h"
+#include "profile.h"
+#include "cal.h"
+#include "prof.h"
+#include "mem.h"
+#include "jitter.h"
 
 // LUFA includes & defines
 #include "Descriptors.h"
 #include <LUFA/Drivers/Peripheral/Serial.h>
+#include <LUFA/Drivers/Peripheral/SerialSPI.h>
 #include <LUFA/Drivers/USB/USB.h>
+#include "usbstat.h" // Needs LUFA types
+#ifdef FNIR_FLASH_AT45DB321C
+#include <LUFA/Drivers/Misc/AT45DB321C.h>
+#else
+#include <LUFA/Drivers/Misc/AT45DB642D.h>
+#endif
+#include "flash.h"
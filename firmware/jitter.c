@@ -0,0 +1,92 @@
+/** @file jitter.c
+* @brief Sample timing jitter histograms
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_JITTER_ENABLE
+
+static uint16_t jitterCount[JITTER_HISTOGRAMS][JITTER_BINS];
+static uint32_t jitterLast[FNIR_CHANNELS]; // Time base at last conversion
+static uint8_t jitterSeen[FNIR_CHANNEL_BYTES]; // One bit per channel converted since start
+static uint32_t jitterMean; // Frame period, CPU cycles << JITTER_MEAN_SHIFT
+static uint8_t jitterSeeded;
+
+static void jitterCountInterval(jitterHistogram_t histogram, uint32_t interval);
+
+void jitterInit(void) {
+    memset(jitterCount, 0, sizeof(jitterCount));
+    memset(jitterSeen, 0, sizeof(jitterSeen));
+    jitterMean = 0;
+    jitterSeeded = 0;
+}
+
+void jitterRecord(uint8_t channel) {
+    uint32_t now;
+    uint32_t interval;
+
+    if (channel >= FNIR_CHANNELS) {
+        return;
+    }
+
+    now = schedNow();
+    interval = now - jitterLast[channel];
+    jitterLast[channel] = now;
+
+    if (!(jitterSeen[channel>>3] & (1<<(channel & 0x07)))) {
+        jitterSeen[channel>>3] |= (1<<(channel & 0x07));
+        return;
+    }
+
+    if (channel == 0) {
+        if (jitterSeeded) {
+            jitterCountInterval(JITTER_FRAME, interval);
+            jitterMean += interval - (jitterMean>>JITTER_MEAN_SHIFT);
+        } else {
+            jitterMean = interval<<JITTER_MEAN_SHIFT;
+            jitterSeeded = 1;
+        }
+    }
+
+    if (jitterSeeded) {
+        jitterCountInterval(JITTER_CHANNEL, interval);
+    }
+}
+
+uint16_t jitterBin(jitterHistogram_t histogram, uint8_t bin) {
+    if ((histogram >= JITTER_HISTOGRAMS) || (bin >= JITTER_BINS)) {
+        return (0);
+    }
+
+    return (jitterCount[histogram][bin]);
+}
+
+uint32_t jitterMeanPeriod(void) {
+    return ((jitterMean>>JITTER_MEAN_SHIFT) / SCHED_COUNTS_PER_US);
+}
+
+/** Counts an interval's deviation from the mean frame period
+*
+* @param histogram Histogram to count in.
+* @param interval  Interval in CPU cycles.
+*/
+static void jitterCountInterval(jitterHistogram_t histogram, uint32_t interval) {
+    uint32_t mean;
+    uint32_t deviation;
+    uint8_t bin;
+
+    mean = jitterMean>>JITTER_MEAN_SHIFT;
+    deviation = ((interval > mean) ? (interval - mean) : (mean - interval))>>JITTER_BIN_SHIFT;
+
+    for (bin = 0; (deviation != 0) && (bin < (JITTER_BINS - 1)); bin++) {
+        deviation >>= 1;
+    }
+
+    if (jitterCount[histogram][bin] != 0xFFFF) {
+        jitterCount[histogram][bin]++;
+    }
+}
+
+#endif
@@ -0,0 +1,66 @@
+/** @file jitter.h
+* @brief Sample timing jitter histograms
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional measurement of scan timing regularity, built in with
+* \c FNIR_JITTER_ENABLE. Every scanned channel is stamped with the scheduler
+* time base as it is handed to processing. Two histograms are kept:
+*
+* - \c JITTER_CHANNEL bins the interval between consecutive conversions of
+*   each channel, over every channel,
+* - \c JITTER_FRAME bins the interval between consecutive frames, taken at
+*   channel 0.
+*
+* Both bin how far an interval deviates from the mean frame period, a
+* running average of frame intervals, so a perfectly regular scan puts every
+* count in bin 0. Bins are log2 of the deviation in units of
+* 2^\ref JITTER_BIN_SHIFT cycles: bin 0 holds deviations under one unit (4us at
+* 16MHz) and bin n those from 2^(n-1) to 2^n - 1 units, with the last bin
+* catching anything longer. Bin counts saturate at 65535.
+*
+* Intervals spanning a stopped scan are not recorded. State is 4 bytes per
+* channel plus 71 bytes.
+*/
+
+#define JITTER_BINS 16 /**< Log2 bins per histogram */
+#define JITTER_BIN_SHIFT 6 /**< Deviations are binned in units of 2^6 CPU cycles */
+#define JITTER_MEAN_SHIFT 3 /**< Frame period averaging shift, each frame moves mean 1/8 of the way */
+
+/** Histograms kept.
+*
+*/
+typedef enum {
+    JITTER_CHANNEL, /**< Interval between conversions of the same channel */
+    JITTER_FRAME, /**< Interval between frames */
+    JITTER_HISTOGRAMS
+} jitterHistogram_t;
+
+/** Clears histograms and forgets last conversion times.
+*
+* Call when the scan starts, so the pause before it is not recorded.
+*
+* @return Function does not return a value.
+*/
+extern void jitterInit(void);
+
+/** Records conversion time of a channel.
+*
+* @param channel Channel scanned.
+*/
+extern void jitterRecord(uint8_t channel);
+
+/** Returns one histogram bin.
+*
+* @param histogram Histogram to read.
+* @param bin       Bin, 0 to \ref JITTER_BINS - 1.
+* @return          Intervals counted in bin.
+*/
+extern uint16_t jitterBin(jitterHistogram_t histogram, uint8_t bin);
+
+/** Returns mean frame period.
+*
+* @return Running average of frame intervals in microseconds, 0 until two
+*         frames have been scanned.
+*/
+extern uint32_t jitterMeanPeriod(void);
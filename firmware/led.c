@@ -0,0 +1,175 @@
+/** @file led.c
+* @brief NIR LED intensity control
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_LED_PWM_ENABLE
+
+static uint8_t ledLevel[FNIR_SOURCES][2];
+static uint16_t ledPeak[FNIR_SOURCES][2]; // Brightest reading this frame
+static uint16_t ledTarget;
+static uint8_t ledLoopEnabled;
+static volatile uint8_t ledMask;
+
+void ledInit(void) {
+    uint8_t source;
+
+    for (source = 0; source < FNIR_SOURCES; source++) {
+        ledLevel[source][0] = LED_FULL_INTENSITY;
+        ledLevel[source][1] = LED_FULL_INTENSITY;
+        ledPeak[source][0] = 0;
+        ledPeak[source][1] = 0;
+    }
+
+    ledTarget = FNIR_LED_TARGET;
+    ledLoopEnabled = 0;
+    ledMask = 0x00;
+
+    // Timer 0 free running in normal mode at F_CPU/64, interrupts off until needed
+    TIMSK0 = 0x00;
+    TCCR0A = 0x00;
+    TCCR0B = ((1<<CS01)|(1<<CS00));
+}
+
+void ledSet(uint8_t mask, uint8_t intensity) {
+    TIMSK0 = 0x00;
+    ledMask = mask;
+
+    if ((mask == 0x00) || (intensity == 0)) {
+        BOARD_LED_PORT = 0x00;
+    } else if (intensity == LED_FULL_INTENSITY) {
+        BOARD_LED_PORT = mask;
+    } else {
+        // Restart period so conversion starts in phase with it
+        OCR0B = intensity;
+        TCNT0 = 0x00;
+        TIFR0 = ((1<<TOV0)|(1<<OCF0B));
+        BOARD_LED_PORT = mask;
+        TIMSK0 = ((1<<TOIE0)|(1<<OCIE0B));
+    }
+}
+
+uint8_t ledIntensity(uint8_t source, uint8_t wavelength) {
+    if ((source >= FNIR_SOURCES) || (wavelength > 1)) {
+        return (0);
+    }
+
+    return (ledLevel[source][wavelength]);
+}
+
+uint8_t ledSetIntensity(uint8_t source, uint8_t wavelength, uint8_t intensity) {
+    if ((source >= FNIR_SOURCES) || (wavelength > 1)) {
+        return (1);
+    }
+
+    ledLevel[source][wavelength] = intensity;
+
+    return (0);
+}
+
+void ledLoopEnable(uint8_t enable) {
+    uint8_t source;
+
+    // Start from a clean frame
+    for (source = 0; source < FNIR_SOURCES; source++) {
+        ledPeak[source][0] = 0;
+        ledPeak[source][1] = 0;
+    }
+
+    ledLoopEnabled = enable;
+}
+
+uint8_t ledLoopIsEnabled(void) {
+    return (ledLoopEnabled);
+}
+
+void ledSetTarget(uint16_t target) {
+    if (target == 0) {
+        target = 1;
+    } else if (target >= ADC_FULL_SCALE) {
+        target = ADC_FULL_SCALE - 1;
+    }
+
+    ledTarget = target;
+}
+
+void ledObserve(uint8_t source, int16_t *level, uint8_t overRange) {
+    uint8_t wavelength;
+
+    if (!ledLoopEnabled || (source >= FNIR_SOURCES)) {
+        return;
+    }
+
+    for (wavelength = 0; wavelength < 2; wavelength++) {
+        if (overRange & (1<<wavelength)) {
+            // Saturated reading says nothing about level, force a halving
+            ledPeak[source][wavelength] = 0xFFFF;
+        } else if ((level[wavelength] > 0) && ((uint16_t)level[wavelength] > ledPeak[source][wavelength])) {
+            ledPeak[source][wavelength] = level[wavelength];
+        }
+    }
+}
+
+uint8_t ledRegulate(void) {
+    uint8_t source;
+    uint8_t wavelength;
+    uint8_t changed;
+    uint16_t peak;
+    uint16_t current;
+    uint16_t next;
+
+    if (!ledLoopEnabled) {
+        return (0);
+    }
+
+    changed = 0;
+
+    for (source = 0; source < FNIR_SOURCES; source++) {
+        for (wavelength = 0; wavelength < 2; wavelength++) {
+            peak = ledPeak[source][wavelength];
+            current = ledLevel[source][wavelength];
+            ledPeak[source][wavelength] = 0;
+
+            if (current == 0) {
+                // Restart a source dimmed to nothing
+                next = 1;
+            } else if (peak <= (ledTarget>>1)) {
+                next = current<<1;
+            } else if (peak >= ((uint32_t)ledTarget<<1)) {
+                next = current>>1;
+            } else {
+                next = ((uint32_t)current*ledTarget + (peak>>1))/peak;
+            }
+
+            if (next > LED_FULL_INTENSITY) {
+                next = LED_FULL_INTENSITY;
+            } else if (next == 0) {
+                next = 1;
+            }
+
+            if (next != ledLevel[source][wavelength]) {
+                ledLevel[source][wavelength] = next;
+                changed = 1;
+            }
+        }
+    }
+
+    return (changed);
+}
+
+/** Switches LEDs on at start of each period.
+*/
+ISR(TIMER0_OVF_vect) {
+    BOARD_LED_PORT = ledMask;
+}
+
+/** Switches LEDs off at end of duty cycle.
+*/
+ISR(TIMER0_COMPB_vect) {
+    BOARD_LED_PORT = 0x00;
+}
+
+#endif
@@ -0,0 +1,97 @@
+/** @file led.h
+* @brief NIR LED intensity control
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional intensity control of the source LEDs, built in with
+* \c FNIR_LED_PWM_ENABLE. The LED FETs on \c BOARD_LED_PORT are duty cycled by timer 0:
+* the overflow interrupt switches the selected LED on and the compare B
+* interrupt switches it off, giving 256 intensity steps at F_CPU/64/256
+* (976Hz at 16MHz) for two short interrupts per period. The timer restarts
+* whenever an LED is selected, so every conversion integrates the same whole
+* number of periods from the same phase. Full intensity leaves the LED on
+* without interrupts, as before.
+*
+* A closed control loop can steer every source towards a target adc level:
+* the brightest dark subtracted reading of each source and wavelength over a
+* frame is compared with the target and the intensity scaled in proportion,
+* at most doubling or halving per frame. An over range reading always halves
+* intensity at the end of its frame. Near optodes are dimmed out of saturation while far ones are
+* driven harder out of the noise floor.
+*/
+
+#ifndef FNIR_LED_TARGET
+#define FNIR_LED_TARGET 19661 /**< Default control target, adc LSBs (60% of full scale) */
+#endif
+
+#define LED_FULL_INTENSITY 255 /**< Intensity leaving LED on continuously */
+
+/** Initializes LED intensity control.
+*
+* Configures timer 0, sets every source to full intensity and leaves the
+* control loop disabled.
+*
+* @return Function does not return a value.
+*/
+extern void ledInit(void);
+
+/** Switches LEDs on \c BOARD_LED_PORT at an intensity.
+*
+* @param mask      LED port pins to drive, 0 turns every LED off.
+* @param intensity Duty cycle in 1/256 steps, \ref LED_FULL_INTENSITY is
+*                  continuously on.
+*/
+extern void ledSet(uint8_t mask, uint8_t intensity);
+
+/** Returns intensity of one source and wavelength.
+*
+* @param source     LED source, 0 to FNIR_SOURCES - 1.
+* @param wavelength 0 for 730nm, 1 for 850nm.
+* @return           Intensity, 0 to \ref LED_FULL_INTENSITY.
+*/
+extern uint8_t ledIntensity(uint8_t source, uint8_t wavelength);
+
+/** Stores intensity of one source and wavelength.
+*
+* @param source     LED source, 0 to FNIR_SOURCES - 1.
+* @param wavelength 0 for 730nm, 1 for 850nm.
+* @param intensity  Intensity, 0 to \ref LED_FULL_INTENSITY.
+* @return           Returns 0 on success, 1 if source or wavelength is out of range.
+*/
+extern uint8_t ledSetIntensity(uint8_t source, uint8_t wavelength, uint8_t intensity);
+
+/** Enables or disables the intensity control loop.
+*
+* @param enable Nonzero to regulate intensities every frame.
+*/
+extern void ledLoopEnable(uint8_t enable);
+
+/** Reports whether the intensity control loop is enabled.
+*
+* @return Nonzero when intensities are being regulated.
+*/
+extern uint8_t ledLoopIsEnabled(void);
+
+/** Sets control loop target.
+*
+* @param target Desired brightest reading of each source, adc LSBs.
+*/
+extern void ledSetTarget(uint16_t target);
+
+/** Records one channel's readings for the control loop.
+*
+* @param source    LED source lighting the channel.
+* @param level     Dark subtracted 730nm and 850nm readings.
+* @param overRange Bit 0 set if the 730nm reading was over range, bit 1 for
+*                  850nm.
+*/
+extern void ledObserve(uint8_t source, int16_t *level, uint8_t overRange);
+
+/** Updates intensities from the readings recorded over the last frame.
+*
+* Call once per frame, before the first channel of the new frame is
+* recorded.
+*
+* @return Returns nonzero if any intensity changed.
+*/
+extern uint8_t ledRegulate(void);
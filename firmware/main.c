@@ -20,30 +20,212 @@ typedef enum {FNIR_NULL, /**< System is taking null offset measurement */
               FNIR_STOP /**< System is paused and will not take measurements */
 } fnir_mode_state_t;
 
+/** Scanned channel waiting for processing */
+typedef struct {
+    uint8_t channel; /**< Channel measured */
+    adcReturn_t level[3]; /**< 730nm, 850nm and dark measurements */
+#ifdef FNIR_BRACKET_ENABLE
+    uint8_t bracketed; /**< Nonzero if darkLevel holds interpolated dark levels */
+    int32_t darkLevel[2]; /**< Dark levels to subtract from 730nm and 850nm */
+#endif
+} fnir_result_t;
+
+#ifdef FNIR_USB_BUFFER_ENABLE
+/** Data line held while host is disconnected */
+typedef struct {
+    uint16_t sequence; /**< Sequence number of data line */
+    uint8_t channel; /**< Channel measured */
+    uint8_t flags; /**< RESULT_FLAG_* bits */
+    int32_t result[3]; /**< 730nm, 850nm and dark results */
+} fnir_record_t;
+#endif
+
+/** Measurement sequence enum */
+typedef enum {SEQUENCE_STANDARD, /**< 730nm, 850nm then dark for each channel */
+              SEQUENCE_BRACKET /**< Dark, 730nm, 850nm, dark with interpolated dark */
+} fnir_sequence_t;
+
 // Private define macros
-#define LED_ON() PORTB |= (1<<PB7)
-#define LED_OFF() PORTB &= ~(1<<PB7)
-#define LED_TOGGLE() PORTB ^= (1<<PB7)
-#define CHIP_SELECT() PORTB |= (1<<PB6)
-#define CHIP_DESELECT() PORTB &= ~(1<<PB6)
+#define LED_ON() BOARD_STATUS_PORT |= BOARD_STATUS_PIN
+#define LED_OFF() BOARD_STATUS_PORT &= ~BOARD_STATUS_PIN
+#define LED_TOGGLE() BOARD_STATUS_PORT ^= BOARD_STATUS_PIN
+#define SCAN_GROUPS (FNIR_CHANNELS/FNIR_ADC_CHIPS) /**< Channels per adc, converted together one per adc */
+#define CHANNEL_CHIP(channel) ((channel)/SCAN_GROUPS) /**< Adc a channel is wired to */
+#define COMMAND_BUFFER_SIZE 40 /**< Longest command line accepted from host */
+#define COMMAND_MAX_ARGUMENTS 6 /**< Most numeric arguments in one command */
+#define RESULT_FLAG_ARTIFACT (1<<0) /**< Result flag, motion artifact detected */
+#define RESULT_FLAG_OVER_730 (1<<1) /**< Result flag, 730nm result over range */
+#define RESULT_FLAG_OVER_850 (1<<2) /**< Result flag, 850nm result over range */
+#define RESULT_FLAG_OVER_DARK (1<<3) /**< Result flag, dark result over range */
+#define RESULT_FLAG_UNDER_730 (1<<4) /**< Result flag, 730nm result under range */
+#define RESULT_FLAG_UNDER_850 (1<<5) /**< Result flag, 850nm result under range */
+#define RESULT_FLAG_UNDER_DARK (1<<6) /**< Result flag, dark result under range */
+#define NO_DETECTOR 0xFF /**< Detector index matching no adc input */
+#if (FNIR_CHANNELS % FNIR_ADC_CHIPS) || (SCAN_GROUPS > ADC_INPUTS)
+#error "FNIR_CHANNELS must be split evenly over FNIR_ADC_CHIPS, at most 16 per adc"
+#endif
+#if (FNIR_ADC_CHIPS > 1) && (defined(FNIR_SPEED_ENABLE) || defined(FNIR_DARK_TRACK_ENABLE) || defined(FNIR_BRACKET_ENABLE))
+#error "Double speed, dark tracking and bracketed sequence support a single adc"
+#endif
+#ifndef FNIR_USB_BUFFER_RECORDS
+#define FNIR_USB_BUFFER_RECORDS (8*BOARD_RAM_SCALE) /**< Data lines held while host is disconnected, 16 bytes each */
+#endif
 
 // Function prototypes
 void mainIoInit(void);
-void mainParseCommand(uint8_t receivedByte);
+void mainParseCommand(int16_t receivedByte);
+void mainExecuteCommand(char *command);
+uint8_t mainParseArguments(char *text, int32_t *argument);
+#ifdef FNIR_IIR_ENABLE
+void mainFilterCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+#endif
+#ifdef FNIR_ARTIFACT_ENABLE
+void mainArtifactCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+#endif
+#ifdef FNIR_STATS_ENABLE
+void mainStatsCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReportStats(uint8_t channel, statsRecord_t *record);
+#endif
+#ifdef FNIR_DARK_TRACK_ENABLE
+void mainDarkCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+#endif
+#ifdef FNIR_TEMP_ENABLE
+void mainTempCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReportTemperature(void);
+#endif
+#if defined(FNIR_SETTLE_ENABLE) || defined(FNIR_LED_PWM_ENABLE)
+void mainLedCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+#endif
+#ifdef FNIR_SETTLE_ENABLE
+void mainCalibrateSettle(void);
+void mainReportSettle(void);
+#endif
+#ifdef FNIR_LED_PWM_ENABLE
+void mainReportIntensity(void);
+#endif
+#ifdef FNIR_BRACKET_ENABLE
+void mainModeCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+#endif
+#ifdef FNIR_SPEED_ENABLE
+void mainSpeedCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReportSpeed(void);
+#endif
+void mainUsbTask(void);
+void mainAcquireTask(void);
+void mainProcessTask(void);
+void mainCommandTask(void);
+void mainHousekeepingTask(void);
+void mainScheduleCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+#ifdef FNIR_PROFILE_ENABLE
+void mainProfileCommand(char subCommand, char *text, int32_t *argument, uint8_t argumentCount);
+void mainRunProfile(void);
+void mainReportProfile(void);
+void EVENT_CDC_Device_ControLineStateChanged(USB_ClassInfo_CDC_Device_t *const CDCInterfaceInfo);
+#endif
+#ifdef FNIR_CAL_ENABLE
+void mainCalCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReceiveCalibration(void);
+void mainLoadCalibration(void);
+void mainReportCalibration(void);
+#endif
+void mainReportSchedule(void);
+#ifdef FNIR_PROF_ENABLE
+void mainReportProfiling(void);
+#endif
+#ifdef FNIR_MEM_ENABLE
+void mainReportMemory(void);
+#endif
+#ifdef FNIR_JITTER_ENABLE
+void mainJitterCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReportJitter(void);
+#endif
+#ifdef FNIR_USB_STATS_ENABLE
+void mainUsbStatCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReportUsbStat(void);
+#endif
+#ifdef FNIR_FLASH_ENABLE
+void mainRecordCommand(char subCommand, int32_t *argument, uint8_t argumentCount);
+void mainReportRecording(void);
+void mainSendDownload(void);
+#endif
 void mainFnirScan(void);
+void mainPostResult(uint8_t channel, adcReturn_t *adcReturnValue, int32_t *darkLevel);
 void mainNirLedControl(fnir_mode_state_t fnirMode, uint8_t channel);
+uint8_t mainChannelSource(uint8_t channel);
+uint8_t mainChannelInput(uint8_t channel);
+uint16_t mainChannelWord(uint8_t channel, adcSpeed_t adcSpeed);
+uint8_t mainChannelDetector(uint8_t channel);
 adcReturn_t mainTakeMeasurement(uint8_t channel);
-void mainReportResult(uint8_t channel, adcReturn_t *adcReturnValue);
+adcReturn_t mainTakeGroup(uint8_t channel, uint8_t slot);
+adcReturn_t mainConvert(uint8_t chip, uint16_t adcWord);
+void mainStartConversion(uint8_t chip, uint16_t adcWord);
+adcReturn_t mainFinishConversion(uint8_t chip);
+void mainProcessResult(uint8_t channel, adcReturn_t *adcReturnValue, int32_t *darkLevel);
+uint8_t mainSampleLevels(int32_t *level, int16_t *sample, uint8_t count);
+void mainReportResult(uint8_t channel, int32_t *result, uint8_t flags);
+#ifdef FNIR_USB_BUFFER_ENABLE
+void mainSendRecord(fnir_record_t *record);
+void mainFlushRecords(void);
+#endif
 void EVENT_USB_Device_Connect(void);
 void EVENT_USB_Device_Disconnect(void);
 void EVENT_USB_Device_ConfigurationChanged(void);
 void EVENT_USB_Device_ControlRequest(void);
 
 // Global variables
-USB_sys_state_t USBSystemState;
+volatile USB_sys_state_t USBSystemState; // Set from USB interrupt events
 fnir_mode_state_t fnirModeState;
+#ifdef FNIR_BRACKET_ENABLE
+fnir_sequence_t sequenceMode;
+uint8_t bracketDarkDetector; // Detector the last trailing dark was taken on
+#endif
+fnir_result_t pendingResult; // Last scanned channel, handed from acquisition to processing
+uint8_t resultPending;
+#if FNIR_ADC_CHIPS > 1
+adcReturn_t groupLevel[FNIR_ADC_CHIPS][3]; // Measurements of the other adcs' channels in the group
+uint8_t groupPost; // Next adc whose channel is handed to processing, FNIR_ADC_CHIPS when none
+uint8_t groupChannel; // Channel of first adc in last scanned group
+#endif
+#ifdef FNIR_USB_BUFFER_ENABLE
+fnir_record_t recordBuffer[FNIR_USB_BUFFER_RECORDS]; // Data lines waiting for host
+uint8_t recordHead;
+uint8_t recordCount;
+uint16_t recordSequence;
+#endif
+#ifdef FNIR_PROFILE_ENABLE
+uint32_t firstFrameTime; // Milliseconds to first data line reported, 0 before
+#endif
+#ifdef FNIR_FLASH_ENABLE
+uint16_t downloadPages; // Pages left to send to host, 0 when no download runs
+uint16_t downloadPage;
+uint16_t downloadOffset;
+#endif
 static FILE USBSerialStream;
 
+/** Scheduler tasks in \ref schedTaskId_t priority order */
+static const schedTask_t mainTasks[SCHED_TASKS] PROGMEM = {
+    mainUsbTask,
+    mainAcquireTask,
+    mainProcessTask,
+    mainCommandTask,
+    mainHousekeepingTask
+};
+
+/** Montage tables generated from the montage description, see Montage/montage.awk */
+static const uint8_t mainMontageSource[FNIR_CHANNELS] PROGMEM = MONTAGE_SOURCE;
+static const uint8_t mainMontageInput[FNIR_CHANNELS] PROGMEM = MONTAGE_INPUT;
+static const uint16_t mainMontageCommand[FNIR_CHANNELS] PROGMEM = MONTAGE_COMMAND;
+static const uint8_t mainScanOrder[SCAN_GROUPS] PROGMEM = MONTAGE_SCAN_ORDER;
+#ifdef FNIR_BRACKET_ENABLE
+static const uint8_t mainBracketOrder[FNIR_CHANNELS] PROGMEM = MONTAGE_BRACKET_ORDER;
+#endif
+#ifdef FNIR_SETTLE_ENABLE
+static const uint8_t mainSourceChannel[FNIR_SOURCES] PROGMEM = MONTAGE_SOURCE_CHANNEL;
+#endif
+#ifdef FNIR_CAL_ENABLE
+static const uint8_t mainMontageGain[FNIR_CHANNELS] PROGMEM = MONTAGE_GAIN;
+#endif
+
 // Class define for USB CDC interface, taken from usb-serial example
 USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface = {
     .Config = {
@@ -73,40 +255,225 @@ USB_ClassInfo_CDC_Device_t VirtualSerial_CDC_Interface = {
 * @return This function should never exit.
 */
 int main(void) {
-    uint8_t receivedByte;
-
     USBSystemState = USB_IDLE;
     fnirModeState = FNIR_STOP;
-
+    resultPending = 0;
+#ifdef FNIR_USB_BUFFER_ENABLE
+    recordHead = 0;
+    recordCount = 0;
+    recordSequence = 0;
+#endif
+
+#ifdef FNIR_PROF_ENABLE
+    profInit();
+#endif
     mainIoInit();
     spiInit();
+#ifdef FNIR_ADC_USART_ENABLE
+    uspiInit();
+#endif
+    adcInit();
+#if FNIR_ADC_CHIPS > 1
+    groupPost = FNIR_ADC_CHIPS;
+#endif
+#ifdef FNIR_IIR_ENABLE
+    iirInit();
+#endif
+#ifdef FNIR_ARTIFACT_ENABLE
+    artifactInit();
+#endif
+#ifdef FNIR_STATS_ENABLE
+    statsInit();
+#endif
+#ifdef FNIR_DARK_TRACK_ENABLE
+    darkInit();
+#endif
+#ifdef FNIR_TEMP_ENABLE
+    tempInit();
+#endif
+#ifdef FNIR_SETTLE_ENABLE
+    settleInit();
+#endif
+#ifdef FNIR_LED_PWM_ENABLE
+    ledInit();
+#endif
+#ifdef FNIR_SPEED_ENABLE
+    speedInit();
+#endif
+#ifdef FNIR_BRACKET_ENABLE
+    sequenceMode = SEQUENCE_STANDARD;
+    bracketDarkDetector = NO_DETECTOR;
+#endif
+#ifdef FNIR_PROFILE_ENABLE
+    profileInit();
+    firstFrameTime = 0;
+#endif
+#ifdef FNIR_CAL_ENABLE
+    calInit();
+    mainLoadCalibration();
+#endif
+#ifdef FNIR_JITTER_ENABLE
+    jitterInit();
+#endif
+#ifdef FNIR_USB_STATS_ENABLE
+    usbStatInit();
+#endif
+#ifdef FNIR_FLASH_ENABLE
+    flashInit();
+    downloadPages = 0;
+#endif
+
+    schedInit(mainTasks);
+
+    // USB is started once, connection state then follows library events
+    USB_Init();
+#ifdef FNIR_USB_STATS_ENABLE
+    usbStatCreateStream(&VirtualSerial_CDC_Interface, &USBSerialStream);
+#else
+    CDC_Device_CreateStream(&VirtualSerial_CDC_Interface, &USBSerialStream);
+#endif
 
     sei();
 
-    for (;;) {
-        switch (USBSystemState) {
-        // When disconnected, attempt to reconnect
-        case (USB_IDLE) :
-            LED_TOGGLE();
-            USB_Init();
-            CDC_Device_CreateStream(&VirtualSerial_CDC_Interface, &USBSerialStream);
-            break;
+#ifdef FNIR_PROFILE_ENABLE
+    // Restore settings of last session before host connects, with interrupts
+    // on so replayed commands run as they would from the host
+    if (profileIsValid()) {
+        mainRunProfile();
+    }
+#endif
 
-        // When connected, parse any received char and take measurements
-        case (USB_CONNECTED) :
-            LED_ON();
-            receivedByte = fgetc(&USBSerialStream);
-            mainParseCommand(receivedByte);
-            mainFnirScan();
+    schedRun();
+}
 
-            // Calls to LUFA
-            CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
-            USB_USBTask();
-            break;
+/** Services LUFA and the CDC interface
+*
+* Readied every millisecond by the scheduler tick. While the host is
+* connected, sends one data line held back during a disconnect and readies
+* the command task when the host has sent data.
+*/
+void mainUsbTask(void) {
+    // Calls to LUFA
+    PROF_BEGIN(PROF_USB_TASK);
+    USB_USBTask();
+    PROF_END(PROF_USB_TASK);
+
+    if (USBSystemState != USB_CONNECTED) {
+        return;
+    }
 
-        default :
-            break;
+#ifdef FNIR_USB_BUFFER_ENABLE
+    mainFlushRecords();
+#endif
+#ifdef FNIR_USB_STATS_ENABLE
+    usbStatFlush(&VirtualSerial_CDC_Interface);
+#endif
+    PROF_BEGIN(PROF_CDC_TASK);
+    CDC_Device_USBTask(&VirtualSerial_CDC_Interface);
+    PROF_END(PROF_CDC_TASK);
+
+    if (CDC_Device_BytesReceived(&VirtualSerial_CDC_Interface)) {
+        schedPost(SCHED_TASK_COMMAND);
+    }
+}
+
+/** Runs one step of the measurement scan
+*
+* Readies itself again until the scan is stopped or a scanned channel is
+* waiting for processing, in which case the process task readies it once
+* the channel has been handled. The scan carries on while the host is
+* disconnected.
+*/
+void mainAcquireTask(void) {
+    if (fnirModeState == FNIR_STOP) {
+        return;
+    }
+
+    mainFnirScan();
+
+    if (!resultPending && (fnirModeState != FNIR_STOP)) {
+        schedPost(SCHED_TASK_ACQUIRE);
+    }
+}
+
+/** Processes and reports the last scanned channel
+*
+*/
+void mainProcessTask(void) {
+    if (!resultPending) {
+        return;
+    }
+
+#ifdef FNIR_BRACKET_ENABLE
+    mainProcessResult(pendingResult.channel, pendingResult.level,
+                      pendingResult.bracketed ? pendingResult.darkLevel : NULL);
+#else
+    mainProcessResult(pendingResult.channel, pendingResult.level, NULL);
+#endif
+
+    resultPending = 0;
+    schedPost(SCHED_TASK_ACQUIRE);
+}
+
+/** Parses every char received from host
+*
+*/
+void mainCommandTask(void) {
+    int16_t receivedByte;
+
+#ifdef FNIR_FLASH_ENABLE
+    if (downloadPages) {
+        mainSendDownload();
+        return;
+    }
+#endif
+
+#ifdef FNIR_CAL_ENABLE
+    if (calIsReceiving()) {
+        mainReceiveCalibration();
+        return;
+    }
+#endif
+
+    while ((receivedByte = fgetc(&USBSerialStream)) != EOF) {
+        mainParseCommand(receivedByte);
+#ifdef FNIR_CAL_ENABLE
+        // Table is only sent after the reply, drop rest of command line
+        if (calIsReceiving()) {
+            while (fgetc(&USBSerialStream) != EOF);
+            return;
         }
+#endif
+    }
+}
+
+/** Keeps status LED up to date
+*
+* Blinks the status LED while disconnected, drops a stalled calibration
+* table transfer and programs the last page of a stopped recording when
+* built in.
+*/
+void mainHousekeepingTask(void) {
+#ifdef FNIR_FLASH_ENABLE
+    flashService();
+#endif
+#ifdef FNIR_CAL_ENABLE
+    if (calTick() == CAL_FAILED) {
+        fprintf(&USBSerialStream, "Calibration timeout\r\n");
+    }
+
+#endif
+    switch (USBSystemState) {
+    case (USB_IDLE) :
+        LED_TOGGLE();
+        break;
+
+    case (USB_CONNECTED) :
+        LED_ON();
+        break;
+
+    default :
+        break;
     }
 }
 
@@ -116,293 +483,2085 @@ int main(void) {
 void mainIoInit(void) {
     // Debug LED
     LED_OFF();
-    DDRB |= (1<<PB7);
+    BOARD_STATUS_DDR |= BOARD_STATUS_PIN;
 
     // SPI
-    DDRB |= ((1<<PB1)|(1<<PB2));
+    BOARD_SPI_DDR |= BOARD_SPI_PINS;
 
     // LED FETs
     mainNirLedControl(FNIR_NULL, 0);
-    DDRD |= 0xFF; // Turn all port d IO to outputs
+    BOARD_LED_DDR |= BOARD_LED_PINS; // Turn LED port IO to outputs, leaving any USART1 pins
 }
 
 /** Parses commands received over usb-serial from host computer
 *
 * Checks the received byte from the usb serial stream device
 * \ref USBSerialStream and passes it through a switch statement.
-* Able to start and stop continuous measurements with chars \c s & \c p.
+* Able to start and stop continuous measurements with chars \c s & \c p,
+* which act immediately when they begin a line. Any other line is buffered
+* until carriage return or newline and handed to \ref mainExecuteCommand.
 *
-* @param receivedByte ASCII char received via usb-serial to be parsed
+* @param receivedByte ASCII char received via usb-serial to be parsed, or EOF
 */
-void mainParseCommand(uint8_t receivedByte) {
+void mainParseCommand(int16_t receivedByte) {
+    static char commandBuffer[COMMAND_BUFFER_SIZE];
+    static uint8_t commandLength = 0;
+
     // Handle messages from host
     switch (receivedByte) {
     case (EOF) :
         break;
 
-    case ('s') :
-        fprintf(&USBSerialStream, "Starting\r\n");
-        fnirModeState = FNIR_IDLE;
+    case ('\r') :
+    case ('\n') :
+        if (commandLength > 0) {
+            commandBuffer[commandLength] = '\0';
+            mainExecuteCommand(commandBuffer);
+            commandLength = 0;
+        }
         break;
 
+    case ('s') :
+        if (commandLength == 0) {
+            fprintf(&USBSerialStream, "Starting\r\n");
+#ifdef FNIR_JITTER_ENABLE
+            jitterInit();
+#endif
+            fnirModeState = FNIR_IDLE;
+            schedPost(SCHED_TASK_ACQUIRE);
+            break;
+        }
+        // Part of a longer command, fall through
+
     case ('p') :
-        fprintf(&USBSerialStream, "Stopping\r\n");
-        fnirModeState = FNIR_STOP;
+        if (commandLength == 0) {
+            fprintf(&USBSerialStream, "Stopping\r\n");
+            fnirModeState = FNIR_STOP;
+#ifdef FNIR_FLASH_ENABLE
+            flashStop();
+#endif
+            break;
+        }
+        // Part of a longer command, fall through
 
     default :
+        // Leave room for terminator, excess chars are dropped
+        if (commandLength < (COMMAND_BUFFER_SIZE-1)) {
+            commandBuffer[commandLength++] = receivedByte;
+        }
         break;
     }
 }
 
-/** Handles measurement of subject
+/** Executes a complete command line received from host computer
 *
-* Cycles through all 16 channels, taking measurements with both types of LEDs
-* as well as a non-LED measurement to calculate an offset value.
+* Commands are a module letter, a command letter and up to
+* \ref COMMAND_MAX_ARGUMENTS comma separated integers, e.g. \c fd4 sets
+* filter decimation to 4.
 *
+* @param command Null terminated command line
 */
-void mainFnirScan(void) {
-    static uint8_t measurementChannelSelected = 0;
-    static adcReturn_t voltageLevel[3];
+void mainExecuteCommand(char *command) {
+    int32_t argument[COMMAND_MAX_ARGUMENTS];
+    uint8_t argumentCount;
 
-    switch (fnirModeState) {
-    case (FNIR_NULL) :
-        fnirModeState = FNIR_730NM;
+    if (command[1] == '\0') {
+        argumentCount = 0;
+    } else {
+        argumentCount = mainParseArguments(&command[2], argument);
+    }
+
+    switch (command[0]) {
+#ifdef FNIR_PROFILE_ENABLE
+    case ('e') :
+        // Text after command letter, empty when there is none
+        mainProfileCommand(command[1], (command[1] == '\0') ? &command[1] : &command[2],
+                           argument, argumentCount);
         break;
+#endif
 
-    case (FNIR_730NM) :
-        mainNirLedControl(fnirModeState, measurementChannelSelected);
-        voltageLevel[0] = mainTakeMeasurement(measurementChannelSelected);
-        fnirModeState = FNIR_850NM;
+    case ('k') :
+        mainScheduleCommand(command[1], argument, argumentCount);
         break;
 
-    case (FNIR_850NM) :
-        mainNirLedControl(fnirModeState, measurementChannelSelected);
-        voltageLevel[1] = mainTakeMeasurement(measurementChannelSelected);
-        fnirModeState = FNIR_IDLE;
+#ifdef FNIR_IIR_ENABLE
+    case ('f') :
+        mainFilterCommand(command[1], argument, argumentCount);
         break;
+#endif
 
-    case (FNIR_IDLE) :
-        mainNirLedControl(fnirModeState, measurementChannelSelected);
-        voltageLevel[2] = mainTakeMeasurement(measurementChannelSelected);
-        fnirModeState = FNIR_NULL;
+#ifdef FNIR_ARTIFACT_ENABLE
+    case ('a') :
+        mainArtifactCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-        // Send measurement via USB.
-        mainReportResult(measurementChannelSelected, voltageLevel);
+#ifdef FNIR_STATS_ENABLE
+    case ('q') :
+        mainStatsCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-        // Move on to next measurement channel, or start back at 0
-        if (measurementChannelSelected < 16) {
-            measurementChannelSelected++;
-        } else {
-            measurementChannelSelected = 0;
-        }
+#ifdef FNIR_DARK_TRACK_ENABLE
+    case ('d') :
+        mainDarkCommand(command[1], argument, argumentCount);
         break;
+#endif
 
-    case (FNIR_STOP) :
+#ifdef FNIR_TEMP_ENABLE
+    case ('t') :
+        mainTempCommand(command[1], argument, argumentCount);
         break;
+#endif
 
-    default:
+#if defined(FNIR_SETTLE_ENABLE) || defined(FNIR_LED_PWM_ENABLE)
+    case ('l') :
+        mainLedCommand(command[1], argument, argumentCount);
         break;
-    }
-}
+#endif
 
-/** Controls selection of near infrared leds.
-*
-* Channel may be 0-3, all leds will turn off when
-* fnirMode == FNIR_IDLE | FNIR_NULL | FNIR_STOP.
-*
-* @param fnirMode LED type to activate
-* @param channel led to activate
-*/
-void mainNirLedControl(fnir_mode_state_t fnirMode, uint8_t channel) {
-    uint8_t ledChannel;
+#ifdef FNIR_BRACKET_ENABLE
+    case ('m') :
+        mainModeCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-    ledChannel = channel/4; // Determine LED pair from desired channel
+#ifdef FNIR_SPEED_ENABLE
+    case ('c') :
+        mainSpeedCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-    // Activate proper led for desired mode and channel
-    if (fnirMode == FNIR_730NM) {
-        switch (ledChannel) {
-        case 0 :
-            PORTD = (1<<PD0);
-            break;
+#ifdef FNIR_CAL_ENABLE
+    case ('b') :
+        mainCalCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-        case 1 :
-            PORTD = (1<<PD2);
-            break;
+#ifdef FNIR_JITTER_ENABLE
+    case ('j') :
+        mainJitterCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-        case 2 :
-            PORTD = (1<<PD4);
-            break;
+#ifdef FNIR_USB_STATS_ENABLE
+    case ('u') :
+        mainUsbStatCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-        case 3 :
-            PORTD = (1<<PD6);
-            break;
+#ifdef FNIR_FLASH_ENABLE
+    case ('r') :
+        mainRecordCommand(command[1], argument, argumentCount);
+        break;
+#endif
 
-        default :
-            break;
-        }
-    } else if (fnirMode == FNIR_850NM) {
-        switch (ledChannel) {
-        case 0 :
-            PORTD = (1<<PD1);
-            break;
+    default :
+        fprintf(&USBSerialStream, "Unknown command\r\n");
+        break;
+    }
+}
 
-        case 1 :
-            PORTD = (1<<PD3);
-            break;
+/** Converts comma separated integer arguments of a command
+*
+* @param text     Argument text following the command letters
+* @param argument Array of at least \ref COMMAND_MAX_ARGUMENTS to fill
+* @return         Number of arguments converted
+*/
+uint8_t mainParseArguments(char *text, int32_t *argument) {
+    uint8_t argumentCount = 0;
+    char *end;
 
-        case 2 :
-            PORTD = (1<<PD5);
-            break;
+    while ((*text != '\0') && (argumentCount < COMMAND_MAX_ARGUMENTS)) {
+        argument[argumentCount] = strtol(text, &end, 0);
 
-        case 3 :
-            PORTD = (1<<PD7);
+        // Stop at first thing that is not a number
+        if (end == text) {
             break;
+        }
 
-        default :
-            break;
+        argumentCount++;
+        text = end;
+
+        if (*text == ',') {
+            text++;
         }
-    // If fnirMode was FNIR_IDLE|FNIR_NULL|FNIR_STOP
-    } else {
-        PORTD = 0x00; // Turn off all IO on port D
     }
+
+    return (argumentCount);
 }
 
-/** Retrieves measurement from ADC
+/** Handles scheduler commands
 *
-* Commands ADC to take measurement from selected channel with selected
-* settings. Blocks until result is returned.
+* - \c kr reports worst case run time of every task, and worst wake to work
+*   latency when sleep is built in
+* - \c kc clears worst case run times and latency, and stage profiles when
+*   profiling is built in
+* - \c kp reports profile of every pipeline stage when profiling is built in
+* - \c km reports RAM headroom when stack painting is built in
 *
-* @param channel channel of measurement to retrieve.
-* @return measurement data
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
 */
-adcReturn_t mainTakeMeasurement(uint8_t channel) {
-    adcReturn_t adcReturnValue;
-    adcChannelType_t adcChannel;
+void mainScheduleCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('r') :
+        mainReportSchedule();
+        return;
+
+    case ('c') :
+        schedClearWorst();
+#ifdef FNIR_PROF_ENABLE
+        profInit();
+#endif
+        fprintf(&USBSerialStream, "Run times cleared\r\n");
+        return;
+
+#ifdef FNIR_PROF_ENABLE
+    case ('p') :
+        mainReportProfiling();
+        return;
+#endif
 
-    // Determine multiplexer setup for desired channel
-    switch (channel) {
-    case 0 :
-        adcChannel = UNIPOLAR_CH_0;
-        break;
+#ifdef FNIR_MEM_ENABLE
+    case ('m') :
+        mainReportMemory();
+        return;
+#endif
 
-    case 1 :
-        adcChannel = UNIPOLAR_CH_1;
+    default :
         break;
+    }
 
-    case 2 :
-    case 4 :
-        adcChannel = UNIPOLAR_CH_2;
-        break;
+    fprintf(&USBSerialStream, "Bad scheduler command\r\n");
+}
 
-    case 3 :
-    case 5 :
-        adcChannel = UNIPOLAR_CH_3;
+#ifdef FNIR_PROFILE_ENABLE
+/** Handles session profile commands
+*
+* - \c ea<command> appends a command line to the profile, e.g. \c eafd4
+* - \c ew<flags> commits profile, flags 1 starts streaming when line opens
+* - \c ec clears profile
+* - \c ex replays profile now
+* - \c el lists profile and reports its state
+*
+* @param subCommand    Command letter following the module letter
+* @param text          Rest of command line after command letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainProfileCommand(char subCommand, char *text, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('a') :
+        // Profile commands are not stored, replay must not recurse
+        if ((text[0] != '\0') && (text[0] != 'e') && (profileAppend(text) == 0)) {
+            mainReportProfile();
+            return;
+        }
         break;
 
-    case 6 :
-    case 8 :
-        adcChannel = UNIPOLAR_CH_4;
+    case ('w') :
+        if (argumentCount <= 1) {
+            profileCommit((argumentCount == 1) ? (uint8_t) argument[0] : 0);
+            mainReportProfile();
+            return;
+        }
         break;
 
-    case 7 :
-    case 9 :
-        adcChannel = UNIPOLAR_CH_5;
-        break;
+    case ('c') :
+        profileClear();
+        mainReportProfile();
+        return;
 
-    case 10 :
-    case 12 :
-        adcChannel = UNIPOLAR_CH_6;
+    case ('x') :
+        if (profileIsValid()) {
+            mainRunProfile();
+            return;
+        }
         break;
 
-    case 11 :
-    case 13 :
-        adcChannel = UNIPOLAR_CH_7;
-        break;
+    case ('l') :
+        mainReportProfile();
+        return;
 
-    case 14 :
-        adcChannel = UNIPOLAR_CH_9;
+    default :
         break;
+    }
+
+    fprintf(&USBSerialStream, "Bad profile command\r\n");
+}
+
+/** Replays every command line of the session profile
+*
+*/
+void mainRunProfile(void) {
+    char line[COMMAND_BUFFER_SIZE];
+    uint16_t offset = 0;
+
+    while (profileReadLine(&offset, line, sizeof(line)) == 0) {
+        if ((line[0] != '\0') && (line[0] != 'e')) {
+            mainExecuteCommand(line);
+        }
+    }
+}
 
-    case 15 :
-        adcChannel = UNIPOLAR_CH_11;
+#endif
+
+#ifdef FNIR_CAL_ENABLE
+/** Handles calibration table commands
+*
+* - \c br reports stored table in one line
+* - \c bw receives a table, see \ref mainReceiveCalibration
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainCalCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('r') :
+        mainReportCalibration();
+        return;
+
+    case ('w') :
+        // Binary transfer needs a host, never start one from a profile
+        if (USBSystemState == USB_CONNECTED) {
+            calBeginReceive();
+            fprintf(&USBSerialStream, "Send %u bytes\r\n", (uint16_t)(sizeof(calTable_t) + 2));
+            return;
+        }
         break;
 
     default :
         break;
     }
 
-    CHIP_SELECT();
+    fprintf(&USBSerialStream, "Bad calibration command\r\n");
+}
 
-    // Command ADC to begin conversion
-    (void) adcSelect(ENABLE,         // Enable adc
-                     adcChannel,     // Select channel
-                     REJECT_60HZ,    // Reject 60hz powerline noise
-                     AUTO_CALIBRATE, // Slower but more accurate speed
-                     GAIN_1X);       // Unity gain (no amplification)
+/** Stores calibration table bytes received from host
+*
+* After replying to \c bw the host sends the table bytes in memory order
+* followed by their CRC-16, both little endian, as one binary transfer. Bytes
+* are written to EEPROM as they arrive, taking only those the EEPROM is ready
+* for so the scan is never held up by a write; the task readies itself again
+* until the transfer ends. The stored table is invalid until the CRC matches.
+*/
+void mainReceiveCalibration(void) {
+    int16_t receivedByte;
 
-    while (PORTB & (1<<PB3)) {} // Wait for conversion complete
+    while (eeprom_is_ready() && ((receivedByte = fgetc(&USBSerialStream)) != EOF)) {
+        switch (calReceive((uint8_t) receivedByte)) {
+        case (CAL_STORED) :
+            mainLoadCalibration();
+            mainReportCalibration();
+            return;
 
-    // Get return value while commanding ADC to shutdown
-    adcReturnValue = adcSelect(DISABLE,        // Disable adc
-                               NULL_CH,        // Null channel
-                               NULL_REJECTION, // Null frequency rejection
-                               NULL_SPEED,     // Null conversion speed
-                               NULL_GAIN);     // Null signal gain
+        case (CAL_FAILED) :
+            fprintf(&USBSerialStream, "Calibration CRC error\r\n");
+            return;
 
-    CHIP_DESELECT();
+        default :
+            break;
+        }
+    }
 
-    return (adcReturnValue);
+    if (!eeprom_is_ready()) {
+        schedPost(SCHED_TASK_COMMAND);
+    }
 }
 
-/** Reports CVS dataset of measurements over USB
+/** Loads stored temperature coefficients into drift correction
 *
-* TODO: calculate estimated oxy content from received values
+* Leaves coefficients untouched without temperature correction built in or
+* without a valid table.
+*/
+void mainLoadCalibration(void) {
+#ifdef FNIR_TEMP_ENABLE
+    int16_t coefficient[2];
+    uint8_t channel;
+
+    for (channel = 0; channel < FNIR_CHANNELS; channel++) {
+        if (calTempCoefficients(channel, coefficient) == 0) {
+            (void) tempSetCoefficients(channel, coefficient);
+        }
+    }
+#endif
+}
+
+/** Reports calibration table over USB
 *
-* @param channel channel measured
-* @param adcReturnValue array of measurements taken from specific channel
+* Sent as one CSV line tagged with \c B carrying whether the table is
+* applied, every table byte as two hex digits in memory order and the CRC of
+* the stored bytes, so the host can read the table back in one transfer.
 */
-void mainReportResult(uint8_t channel, adcReturn_t *adcReturnValue) {
-    uint16_t estimatedOxyContent;
+void mainReportCalibration(void) {
+    uint16_t offset;
+
+    fprintf(&USBSerialStream, "B,%d,", ((uint16_t) calIsValid()));
 
-    fprintf(&USBSerialStream, "%d,%d,%d,%d,%d\r\n", // CSV string
-            ((uint16_t) channel),                   // Reported channel
-            adcReturnValue[0].returnValue,          // 730nm result
-            adcReturnValue[1].returnValue,          // 850nm result
-            adcReturnValue[2].returnValue,          // Dark result
-            estimatedOxyContent);                   // Calculated oxy value
+    for (offset = 0; offset < sizeof(calTable_t); offset++) {
+        fprintf(&USBSerialStream, "%02X", calReadByte(offset));
+    }
+
+    fprintf(&USBSerialStream, ",%04X\r\n", calCrc());
 }
+#endif
 
-/** Event handler for the library USB Connection event. 
+#ifdef FNIR_JITTER_ENABLE
+/** Handles timing jitter commands
 *
-* Stops connection attempts from being made after the host device enumerates
-* the system and prints "Device connected" onto the serial terminal.
-* 
-* @return This function does not return a value.
+* - \c jr reports both jitter histograms
+* - \c jc clears histograms
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
 */
-void EVENT_USB_Device_Connect(void) {
-    fprintf(&USBSerialStream, "Device Connected\r\n");
-    USBSystemState = USB_CONNECTED;
+void mainJitterCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('r') :
+        mainReportJitter();
+        return;
+
+    case ('c') :
+        jitterInit();
+        fprintf(&USBSerialStream, "Jitter cleared\r\n");
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad jitter command\r\n");
 }
+#endif
 
-/** Event handler for the library USB Disconnection event.
+#ifdef FNIR_USB_STATS_ENABLE
+/** Handles USB transport counter commands
 *
-* Starts looping device connection attempts when if device becomes
-* disconnected.
+* - \c ur reports transport counters
+* - \c uc clears counters
 *
-* @return This function does not return a value.
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
 */
-void EVENT_USB_Device_Disconnect(void) {
-    USBSystemState = USB_IDLE;
+void mainUsbStatCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('r') :
+        mainReportUsbStat();
+        return;
+
+    case ('c') :
+        usbStatInit();
+        fprintf(&USBSerialStream, "USB counters cleared\r\n");
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad USB command\r\n");
 }
+#endif
 
-/** Event handler for the library USB Configuration Changed event.
+#ifdef FNIR_FLASH_ENABLE
+/** Handles dataflash recording commands
 *
+* - \c rs starts scanning and recording to dataflash, \c p stops both
+* - \c rr reports recording state
+* - \c rd sends the last recording to the host, see \ref mainSendDownload
 *
-* @return This function does not return a value.
+* Recording and download both need the scan stopped to start.
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
 */
-void EVENT_USB_Device_ConfigurationChanged(void) {
-    CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface);
+void mainRecordCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('s') :
+        if ((fnirModeState == FNIR_STOP) && !flashIsRecording()) {
+            if (flashStart()) {
+                fprintf(&USBSerialStream, "No dataflash\r\n");
+                return;
+            }
+
+            fprintf(&USBSerialStream, "Recording\r\n");
+#ifdef FNIR_JITTER_ENABLE
+            jitterInit();
+#endif
+            fnirModeState = FNIR_IDLE;
+            schedPost(SCHED_TASK_ACQUIRE);
+            return;
+        }
+        break;
+
+    case ('r') :
+        mainReportRecording();
+        return;
+
+    case ('d') :
+        // Raw transfer needs a host, never start one from a profile
+        if ((fnirModeState == FNIR_STOP) && !flashIsRecording() && (USBSystemState == USB_CONNECTED)) {
+            downloadPages = flashRecordedPages();
+            downloadPage = 0;
+            downloadOffset = 0;
+            fprintf(&USBSerialStream, "D,%u,%u\r\n", downloadPages, (uint16_t) FLASH_PAGE_SIZE);
+
+            if (downloadPages) {
+                schedPost(SCHED_TASK_COMMAND);
+            }
+            return;
+        }
+        break;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad record command\r\n");
+}
+
+/** Reports dataflash recording state over USB
+*
+* Sent as one CSV line tagged with \c R carrying whether a recording is
+* running or being flushed, its session number, pages programmed, frames
+* recorded and frames dropped.
+*/
+void mainReportRecording(void) {
+    fprintf(&USBSerialStream, "R,%d,%u,%u,%lu,%u\r\n",
+            ((uint16_t) flashIsRecording()),
+            flashSession(),
+            flashPagesWritten(),
+            flashFrames(),
+            flashDropped());
+}
+
+/** Sends part of a recording to the host
+*
+* After the \c D line answering \c rd the host receives every recorded page
+* in order as raw bytes, \c FLASH_PAGE_SIZE per page. Each page starts with
+* its session number and frame count, both 16 bit little endian, followed by
+* that many \ref flashFrame_t frames; the rest of the page is padding. One
+* chunk is sent per run and the task readies itself again until the last
+* page has gone, or the host disconnects.
+*/
+void mainSendDownload(void) {
+    uint8_t chunk[32];
+    uint8_t length;
+    uint8_t index;
+
+    if (USBSystemState != USB_CONNECTED) {
+        downloadPages = 0;
+        return;
+    }
+
+    length = sizeof(chunk);
+
+    if (length > (FLASH_PAGE_SIZE - downloadOffset)) {
+        length = FLASH_PAGE_SIZE - downloadOffset;
+    }
+
+    flashRead(downloadPage, downloadOffset, chunk, length);
+
+    for (index = 0; index < length; index++) {
+        fputc(chunk[index], &USBSerialStream);
+    }
+
+    downloadOffset += length;
+
+    if (downloadOffset >= FLASH_PAGE_SIZE) {
+        downloadOffset = 0;
+        downloadPage++;
+        downloadPages--;
+    }
+
+    if (downloadPages) {
+        schedPost(SCHED_TASK_COMMAND);
+    }
+}
+#endif
+
+#ifdef FNIR_IIR_ENABLE
+/** Handles filter bank commands
+*
+* - \c fe<0|1> disables or enables the filter stage
+* - \c fc<section>,<b0>,<b1>,<b2>,<a1>,<a2> loads Q2.14 section coefficients
+* - \c fd<factor> sets frame decimation factor
+* - \c fm reports filter bank RAM use against its budget
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainFilterCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    iirCoefficients_t coefficients;
+
+    switch (subCommand) {
+    case ('e') :
+        if (argumentCount == 1) {
+            iirEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Filter %s\r\n", iirIsEnabled() ? "on" : "off");
+            return;
+        }
+        break;
+
+    case ('c') :
+        if (argumentCount == 6) {
+            coefficients.b0 = (int16_t) argument[1];
+            coefficients.b1 = (int16_t) argument[2];
+            coefficients.b2 = (int16_t) argument[3];
+            coefficients.a1 = (int16_t) argument[4];
+            coefficients.a2 = (int16_t) argument[5];
+
+            if (iirSetCoefficients((uint8_t) argument[0], &coefficients) == 0) {
+                fprintf(&USBSerialStream, "Filter section %d set\r\n", (int16_t) argument[0]);
+                return;
+            }
+        }
+        break;
+
+    case ('d') :
+        if (argumentCount == 1) {
+            iirSetDecimation((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Filter decimation %d\r\n", (int16_t) argument[0]);
+            return;
+        }
+        break;
+
+    case ('m') :
+        fprintf(&USBSerialStream, "Filter RAM %d of %d bytes, %d ch x %d sections\r\n",
+                IIR_RAM_BYTES,
+                FNIR_IIR_RAM_BUDGET,
+                FNIR_IIR_CHANNELS,
+                FNIR_IIR_SECTIONS);
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad filter command\r\n");
+}
+#endif
+
+#ifdef FNIR_ARTIFACT_ENABLE
+/** Handles motion artifact detector commands
+*
+* - \c ae<0|1> disables or enables the detector
+* - \c at<counts> sets sample to sample step threshold
+* - \c ah<frames> sets number of frames a flag is held
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainArtifactCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    if (argumentCount == 1) {
+        switch (subCommand) {
+        case ('e') :
+            artifactEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Artifact %s\r\n", artifactIsEnabled() ? "on" : "off");
+            return;
+
+        case ('t') :
+            artifactSetThreshold((uint16_t) argument[0]);
+            fprintf(&USBSerialStream, "Artifact threshold %u\r\n", (uint16_t) argument[0]);
+            return;
+
+        case ('h') :
+            artifactSetHold((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Artifact hold %u\r\n", (uint8_t) argument[0]);
+            return;
+
+        default :
+            break;
+        }
+    }
+
+    fprintf(&USBSerialStream, "Bad artifact command\r\n");
+}
+#endif
+
+#ifdef FNIR_STATS_ENABLE
+/** Handles signal quality statistics commands
+*
+* - \c qe<0|1> disables or enables statistics
+* - \c qw<frames> sets frames per statistics window
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainStatsCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    if (argumentCount == 1) {
+        switch (subCommand) {
+        case ('e') :
+            statsEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Stats %s\r\n", statsIsEnabled() ? "on" : "off");
+            return;
+
+        case ('w') :
+            statsSetWindow((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Stats window %u\r\n", (uint8_t) argument[0]);
+            return;
+
+        default :
+            break;
+        }
+    }
+
+    fprintf(&USBSerialStream, "Bad stats command\r\n");
+}
+#endif
+
+#ifdef FNIR_DARK_TRACK_ENABLE
+/** Handles dark tracking commands
+*
+* - \c de<0|1> selects dark measurement every frame or tracked dark level
+* - \c di<frames> sets frames between dark refreshes
+* - \c ds<shift> sets exponential averaging weight to 1/2^shift
+* - \c dr forces a dark refresh on the next frame
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainDarkCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('e') :
+        if (argumentCount == 1) {
+            darkEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Dark tracking %s\r\n", darkIsEnabled() ? "on" : "off");
+            return;
+        }
+        break;
+
+    case ('i') :
+        if (argumentCount == 1) {
+            darkSetInterval((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Dark interval %u\r\n", (uint8_t) argument[0]);
+            return;
+        }
+        break;
+
+    case ('s') :
+        if (argumentCount == 1) {
+            darkSetShift((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Dark shift %u\r\n", (uint8_t) argument[0]);
+            return;
+        }
+        break;
+
+    case ('r') :
+        darkInvalidate();
+        fprintf(&USBSerialStream, "Dark refresh\r\n");
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad dark command\r\n");
+}
+#endif
+
+#ifdef FNIR_TEMP_ENABLE
+/** Handles temperature monitoring commands
+*
+* - \c te<0|1> disables or enables temperature conversions and correction
+* - \c ti<frames> sets frames between temperature conversions
+* - \c tc<channel>,<c730>,<c850> loads Q8 drift coefficients of a channel
+* - \c tr captures last reading as drift reference temperature
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainTempCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    int16_t coefficient[2];
+
+    switch (subCommand) {
+    case ('e') :
+        if (argumentCount == 1) {
+            tempEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Temperature %s\r\n", tempIsEnabled() ? "on" : "off");
+            return;
+        }
+        break;
+
+    case ('i') :
+        if (argumentCount == 1) {
+            tempSetInterval((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Temperature interval %u\r\n", (uint8_t) argument[0]);
+            return;
+        }
+        break;
+
+    case ('c') :
+        if (argumentCount == 3) {
+            coefficient[0] = (int16_t) argument[1];
+            coefficient[1] = (int16_t) argument[2];
+
+            if (tempSetCoefficients((uint8_t) argument[0], coefficient) == 0) {
+                fprintf(&USBSerialStream, "Temperature channel %d set\r\n", (int16_t) argument[0]);
+                return;
+            }
+        }
+        break;
+
+    case ('r') :
+        tempSetReference();
+        mainReportTemperature();
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad temperature command\r\n");
+}
+#endif
+
+#if defined(FNIR_SETTLE_ENABLE) || defined(FNIR_LED_PWM_ENABLE)
+/** Handles LED commands
+*
+* Wavelength arguments are 0 for 730nm and 1 for 850nm.
+*
+* - \c lc runs settle delay calibration sweep, blocking for several seconds
+* - \c ld<source>,<wavelength>,<us> sets settle delay of one source
+* - \c li<source>,<wavelength>,<intensity> sets intensity of one source,
+*   0 to 255
+* - \c le<0|1> disables or enables closed loop intensity control
+* - \c lt<level> sets intensity control target in adc LSBs
+* - \c lr reports settle delay and intensity tables
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainLedCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+#ifdef FNIR_SETTLE_ENABLE
+    case ('c') :
+        mainCalibrateSettle();
+        mainReportSettle();
+        return;
+
+    case ('d') :
+        if ((argumentCount == 3)
+            && (settleSet((uint8_t) argument[0], (uint8_t) argument[1], (uint16_t) argument[2]) == 0)) {
+            mainReportSettle();
+            return;
+        }
+        break;
+#endif
+
+#ifdef FNIR_LED_PWM_ENABLE
+    case ('i') :
+        if ((argumentCount == 3) && (argument[2] >= 0) && (argument[2] <= LED_FULL_INTENSITY)
+            && (ledSetIntensity((uint8_t) argument[0], (uint8_t) argument[1], (uint8_t) argument[2]) == 0)) {
+            mainReportIntensity();
+            return;
+        }
+        break;
+
+    case ('e') :
+        if (argumentCount == 1) {
+            ledLoopEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Intensity loop %s\r\n", ledLoopIsEnabled() ? "on" : "off");
+            return;
+        }
+        break;
+
+    case ('t') :
+        if ((argumentCount == 1) && (argument[0] > 0) && (argument[0] < ADC_FULL_SCALE)) {
+            ledSetTarget((uint16_t) argument[0]);
+            fprintf(&USBSerialStream, "Intensity target %ld\r\n", argument[0]);
+            return;
+        }
+        break;
+#endif
+
+    case ('r') :
+#ifdef FNIR_SETTLE_ENABLE
+        mainReportSettle();
+#endif
+#ifdef FNIR_LED_PWM_ENABLE
+        mainReportIntensity();
+#endif
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad LED command\r\n");
+}
+#endif
+
+#ifdef FNIR_BRACKET_ENABLE
+/** Handles measurement mode commands
+*
+* - \c mb<0|1> selects standard or dark bracketed sequence, taking effect
+*   from the next channel
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainModeCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    if ((subCommand == 'b') && (argumentCount == 1)) {
+        sequenceMode = argument[0] ? SEQUENCE_BRACKET : SEQUENCE_STANDARD;
+        bracketDarkDetector = NO_DETECTOR;
+        fprintf(&USBSerialStream, "Bracket %s\r\n", (sequenceMode == SEQUENCE_BRACKET) ? "on" : "off");
+        return;
+    }
+
+    fprintf(&USBSerialStream, "Bad mode command\r\n");
+}
+#endif
+
+#ifdef FNIR_SPEED_ENABLE
+/** Handles conversion speed commands
+*
+* - \c ce<0|1> selects auto calibrated or offset corrected double speed
+*   conversions
+* - \c ci<frames> sets frames between offset calibrations
+* - \c cr reports offset of every detector
+*
+* @param subCommand    Command letter following the module letter
+* @param argument      Numeric arguments of command
+* @param argumentCount Number of valid entries in argument
+*/
+void mainSpeedCommand(char subCommand, int32_t *argument, uint8_t argumentCount) {
+    switch (subCommand) {
+    case ('e') :
+        if (argumentCount == 1) {
+            speedEnable((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Double speed %s\r\n", speedIsEnabled() ? "on" : "off");
+            return;
+        }
+        break;
+
+    case ('i') :
+        if (argumentCount == 1) {
+            speedSetInterval((uint8_t) argument[0]);
+            fprintf(&USBSerialStream, "Calibration interval %u\r\n", (uint8_t) argument[0]);
+            return;
+        }
+        break;
+
+    case ('r') :
+        mainReportSpeed();
+        return;
+
+    default :
+        break;
+    }
+
+    fprintf(&USBSerialStream, "Bad speed command\r\n");
+}
+#endif
+
+/** Handles measurement of subject
+*
+* Cycles through the montage's channels in its scan order, taking
+* measurements with both types of LEDs as well as a non-LED measurement to
+* calculate an offset value.
+*
+* With several adcs the channels are scanned in groups of one channel per
+* adc, lit by the same source. Each conversion of a group is started on
+* every adc before the first is read, so the adcs convert side by side and a
+* frame takes as long as a single adc's share of it. The other adcs' channels
+* are handed to processing one per call once the group is complete.
+*
+* In the standard sequence each channel is measured 730nm, 850nm then dark.
+* The bracketed sequence instead measures dark, 730nm, 850nm, dark and
+* subtracts a dark level interpolated to the time of each lit conversion,
+* cancelling slowly flickering room light. Channels sharing a detector are
+* scanned back to back in this mode, so a trailing dark also serves as the
+* leading dark of the next channel and a detector group of n channels costs
+* n+1 dark conversions.
+*/
+void mainFnirScan(void) {
+    static uint8_t measurementChannelSelected = 0;
+    static uint8_t measurementPosition = 0; // Position of selected channel in montage scan order
+    static adcReturn_t voltageLevel[3];
+#if defined(FNIR_DARK_TRACK_ENABLE) || defined(FNIR_SPEED_ENABLE)
+    uint8_t detector;
+#endif
+#ifdef FNIR_SPEED_ENABLE
+    int32_t calibrated;
+#endif
+#ifdef FNIR_BRACKET_ENABLE
+    static adcReturn_t leadingDark;
+    uint8_t scanPosition;
+    int32_t darkLevel[2];
+    int32_t darkStep;
+    adcReturn_t trailingDark;
+    uint8_t bracketDetector;
+#endif
+
+#if FNIR_ADC_CHIPS > 1
+    // Finish handing over last group before starting the next
+    if (groupPost < FNIR_ADC_CHIPS) {
+        mainPostResult(groupChannel + (groupPost * SCAN_GROUPS), groupLevel[groupPost], NULL);
+        groupPost++;
+        return;
+    }
+#endif
+
+    switch (fnirModeState) {
+    case (FNIR_NULL) :
+#ifdef FNIR_LED_PWM_ENABLE
+        // Apply last frame's intensity corrections before any LED of this one
+        if ((measurementChannelSelected == 0) && ledRegulate()) {
+            mainReportIntensity();
+        }
+#endif
+#ifdef FNIR_TEMP_ENABLE
+        // Interleave temperature conversion at start of frame, LEDs are off
+        if ((measurementChannelSelected == 0) && tempIsEnabled() && tempConversionDue()) {
+            tempUpdate(q15Saturate(mainConvert(0, ADC_WORD_TEMPERATURE(MONTAGE_REJECTION)).returnValue));
+            mainReportTemperature();
+        }
+#endif
+#ifdef FNIR_SPEED_ENABLE
+        // Measure double speed offset of this detector, LEDs are off
+        if (speedIsEnabled()) {
+            detector = mainChannelInput(measurementChannelSelected);
+
+            if (speedCalibrationDue(measurementChannelSelected, detector)) {
+                mainNirLedControl(FNIR_NULL, measurementChannelSelected);
+                calibrated = mainConvert(0, mainChannelWord(measurementChannelSelected, AUTO_CALIBRATE)).returnValue;
+                speedUpdate(detector, calibrated, mainConvert(0, mainChannelWord(measurementChannelSelected, DOUBLE_SPEED)).returnValue);
+            }
+        }
+#endif
+#ifdef FNIR_BRACKET_ENABLE
+        // Take leading dark unless last trailing dark was on this detector
+        if (sequenceMode == SEQUENCE_BRACKET) {
+            bracketDetector = mainChannelInput(measurementChannelSelected);
+
+            if (bracketDetector != bracketDarkDetector) {
+                mainNirLedControl(FNIR_NULL, measurementChannelSelected);
+                leadingDark = mainTakeMeasurement(measurementChannelSelected);
+                bracketDarkDetector = bracketDetector;
+            }
+        }
+#endif
+        fnirModeState = FNIR_730NM;
+        break;
+    case (FNIR_730NM) :
+        mainNirLedControl(fnirModeState, measurementChannelSelected);
+#ifdef FNIR_SETTLE_ENABLE
+        settleWait(settleGet(mainChannelSource(measurementChannelSelected), 0));
+#endif
+        voltageLevel[0] = mainTakeGroup(measurementChannelSelected, 0);
+        fnirModeState = FNIR_850NM;
+        break;
+
+    case (FNIR_850NM) :
+        mainNirLedControl(fnirModeState, measurementChannelSelected);
+#ifdef FNIR_SETTLE_ENABLE
+        settleWait(settleGet(mainChannelSource(measurementChannelSelected), 1));
+#endif
+        voltageLevel[1] = mainTakeGroup(measurementChannelSelected, 1);
+        fnirModeState = FNIR_IDLE;
+        break;
+
+    case (FNIR_IDLE) :
+        mainNirLedControl(fnirModeState, measurementChannelSelected);
+#ifdef FNIR_SETTLE_ENABLE
+        // Let the 850nm LED just switched off decay as long as it took to rise
+        settleWait(settleGet(mainChannelSource(measurementChannelSelected), 1));
+#endif
+#ifdef FNIR_BRACKET_ENABLE
+        if (sequenceMode == SEQUENCE_BRACKET) {
+            trailingDark = mainTakeMeasurement(measurementChannelSelected);
+            fnirModeState = FNIR_NULL;
+
+            // Conversions are evenly spaced, dark at 0 and 3, lit at 1 and 2
+            darkStep = (trailingDark.returnValue - leadingDark.returnValue) / 3;
+            darkLevel[0] = leadingDark.returnValue + darkStep;
+            darkLevel[1] = trailingDark.returnValue - darkStep;
+
+            // Report mean dark of the bracket, flagging either end out of range
+            voltageLevel[2].returnValue = (leadingDark.returnValue + trailingDark.returnValue) / 2;
+            voltageLevel[2].overRange = leadingDark.overRange | trailingDark.overRange;
+            voltageLevel[2].underRange = leadingDark.underRange | trailingDark.underRange;
+            voltageLevel[2].conversionOngoing = trailingDark.conversionOngoing;
+
+            // Trailing dark, not the mean, leads the next channel if it shares the detector
+            leadingDark = trailingDark;
+
+            mainPostResult(measurementChannelSelected, voltageLevel, darkLevel);
+
+            // Move on to next channel in detector order, or start back at first
+            scanPosition = 0;
+            while (pgm_read_byte(&mainBracketOrder[scanPosition]) != measurementChannelSelected) {
+                scanPosition++;
+            }
+
+            if (scanPosition < (FNIR_CHANNELS-1)) {
+                scanPosition++;
+            } else {
+                scanPosition = 0;
+            }
+
+            measurementChannelSelected = pgm_read_byte(&mainBracketOrder[scanPosition]);
+            break;
+        }
+#endif
+#ifdef FNIR_DARK_TRACK_ENABLE
+        // Only spend a conversion on dark level when the estimate is due
+        if (darkIsEnabled()) {
+            detector = mainChannelInput(measurementChannelSelected);
+
+            if (darkRefreshDue(measurementChannelSelected, detector)) {
+                voltageLevel[2] = mainTakeMeasurement(measurementChannelSelected);
+                darkUpdate(detector, voltageLevel[2].returnValue);
+            }
+
+            voltageLevel[2].returnValue = darkEstimate(detector);
+            voltageLevel[2].overRange = 0;
+            voltageLevel[2].underRange = 0;
+        } else {
+            voltageLevel[2] = mainTakeGroup(measurementChannelSelected, 2);
+        }
+#else
+        voltageLevel[2] = mainTakeGroup(measurementChannelSelected, 2);
+#endif
+        fnirModeState = FNIR_NULL;
+
+        // Hand measurement over for processing and sending via USB.
+        mainPostResult(measurementChannelSelected, voltageLevel, NULL);
+#if FNIR_ADC_CHIPS > 1
+        groupChannel = measurementChannelSelected;
+        groupPost = 1;
+#endif
+
+        // Move on to next measurement channel group in montage order, or start back at first
+        if (measurementPosition < (SCAN_GROUPS-1)) {
+            measurementPosition++;
+        } else {
+            measurementPosition = 0;
+        }
+
+        measurementChannelSelected = pgm_read_byte(&mainScanOrder[measurementPosition]);
+        break;
+
+    case (FNIR_STOP) :
+        break;
+
+    default:
+        break;
+    }
+}
+
+/** Controls selection of near infrared leds.
+*
+* Channel may be 0-3, all leds will turn off when
+* fnirMode == FNIR_IDLE | FNIR_NULL | FNIR_STOP. With LED intensity control
+* built in the led is driven at the intensity of its source and wavelength.
+*
+* @param fnirMode LED type to activate
+* @param channel led to activate
+*/
+void mainNirLedControl(fnir_mode_state_t fnirMode, uint8_t channel) {
+    uint8_t ledChannel;
+    uint8_t ledPins = 0x00;
+
+    PROF_BEGIN(PROF_LED_CONTROL);
+    ledChannel = mainChannelSource(channel); // Determine LED pair from desired channel
+
+    // Activate proper led for desired mode and channel
+    if ((fnirMode == FNIR_730NM) && (ledChannel < FNIR_SOURCES)) {
+        ledPins = BOARD_LED_PIN(ledChannel, 0);
+    } else if ((fnirMode == FNIR_850NM) && (ledChannel < FNIR_SOURCES)) {
+        ledPins = BOARD_LED_PIN(ledChannel, 1);
+    }
+
+    // If fnirMode was FNIR_IDLE|FNIR_NULL|FNIR_STOP all LED IO turns off
+#ifdef FNIR_LED_PWM_ENABLE
+    ledSet(ledPins, ledIntensity(ledChannel, (fnirMode == FNIR_850NM) ? 1 : 0));
+#else
+    BOARD_LED_PORT = ledPins;
+#endif
+    PROF_END(PROF_LED_CONTROL);
+}
+
+#ifdef FNIR_SETTLE_ENABLE
+/** Calibrates LED settle delay of every source and wavelength
+*
+* For each source the first channel it lights is measured after a long
+* \c FNIR_SETTLE_REFERENCE_US settle, then after each candidate delay from
+* shortest up, with the LEDs switched off for the reference time before each
+* attempt. The first delay whose reading is within \c FNIR_SETTLE_TOLERANCE
+* of the reference is stored; if none is, the reference time is stored.
+* Blocks for roughly ten conversions per source and wavelength.
+*/
+void mainCalibrateSettle(void) {
+    uint8_t source;
+    uint8_t wavelength;
+    uint8_t candidateIndex;
+    uint8_t channel;
+    uint16_t candidate;
+    int32_t reference;
+    int32_t reading;
+    fnir_mode_state_t ledMode;
+
+    for (source = 0; source < FNIR_SOURCES; source++) {
+        channel = pgm_read_byte(&mainSourceChannel[source]);
+
+        for (wavelength = 0; wavelength < 2; wavelength++) {
+            ledMode = (wavelength == 0) ? FNIR_730NM : FNIR_850NM;
+
+            // Reference reading from a fully settled LED
+            mainNirLedControl(FNIR_IDLE, channel);
+            settleWait(FNIR_SETTLE_REFERENCE_US);
+            mainNirLedControl(ledMode, channel);
+            settleWait(FNIR_SETTLE_REFERENCE_US);
+            reference = mainTakeMeasurement(channel).returnValue;
+
+            (void) settleSet(source, wavelength, FNIR_SETTLE_REFERENCE_US);
+
+            // Sweep from shortest delay, keep first that matches reference
+            for (candidateIndex = 0;
+                 (candidate = settleCandidate(candidateIndex)) != 0xFFFF;
+                 candidateIndex++) {
+                mainNirLedControl(FNIR_IDLE, channel);
+                settleWait(FNIR_SETTLE_REFERENCE_US);
+                mainNirLedControl(ledMode, channel);
+                settleWait(candidate);
+                reading = mainTakeMeasurement(channel).returnValue;
+
+                if (labs(reading - reference) <= FNIR_SETTLE_TOLERANCE) {
+                    (void) settleSet(source, wavelength, candidate);
+                    break;
+                }
+            }
+        }
+    }
+
+    mainNirLedControl(FNIR_IDLE, 0);
+}
+#endif
+
+/** Looks up LED source lighting a measurement channel
+*
+* @param channel measurement channel, 0 to FNIR_CHANNELS - 1
+* @return LED source, 0 to FNIR_SOURCES - 1
+*/
+uint8_t mainChannelSource(uint8_t channel) {
+    return (pgm_read_byte(&mainMontageSource[channel]));
+}
+
+/** Looks up adc multiplexer input wired to a measurement channel
+*
+* Neighbouring channels share a detector, so several channels map onto the
+* same adc input.
+*
+* @param channel measurement channel, 0 to FNIR_CHANNELS - 1
+* @return unipolar input of that channel's detector on its adc, 0 to 15
+*/
+uint8_t mainChannelInput(uint8_t channel) {
+    return (pgm_read_byte(&mainMontageInput[channel]));
+}
+
+/** Looks up adc command word converting a measurement channel
+*
+* Words are built at compile time from the montage with the detector's gain
+* and powerline rejection, in auto calibrated mode.
+*
+* @param channel measurement channel, 0 to FNIR_CHANNELS - 1
+* @param adcSpeed conversion speed
+* @return command word for \ref adcSelectWord
+*/
+uint16_t mainChannelWord(uint8_t channel, adcSpeed_t adcSpeed) {
+    uint16_t adcWord;
+
+    adcWord = pgm_read_word(&mainMontageCommand[channel]);
+
+    if (adcSpeed == DOUBLE_SPEED) {
+        adcWord |= ADC_WORD_DOUBLE_SPEED;
+    }
+
+    return (adcWord);
+}
+
+/** Numbers the detector of a measurement channel
+*
+* @param channel measurement channel, 0 to FNIR_CHANNELS - 1
+* @return detector across all adcs, adc index times \ref ADC_INPUTS plus input
+*/
+uint8_t mainChannelDetector(uint8_t channel) {
+    return ((CHANNEL_CHIP(channel) * ADC_INPUTS) + mainChannelInput(channel));
+}
+
+/** Retrieves measurement from ADC
+*
+* Commands ADC to take measurement from selected channel with selected
+* settings. Blocks until result is returned. With double speed conversions
+* enabled the measured offset of the channel's detector is subtracted.
+*
+* @param channel channel of measurement to retrieve.
+* @return measurement data
+*/
+adcReturn_t mainTakeMeasurement(uint8_t channel) {
+#ifdef FNIR_SPEED_ENABLE
+    adcReturn_t adcReturnValue;
+
+    if (speedIsEnabled()) {
+        adcReturnValue = mainConvert(0, mainChannelWord(channel, DOUBLE_SPEED));
+        adcReturnValue.returnValue -= speedOffset(mainChannelInput(channel));
+
+        return (adcReturnValue);
+    }
+#endif
+
+    return (mainConvert(CHANNEL_CHIP(channel), mainChannelWord(channel, AUTO_CALIBRATE)));
+}
+
+/** Retrieves measurements of a channel group from every ADC
+*
+* Starts the conversion on every adc before reading the first, so they
+* convert at the same time. With a single adc this is
+* \ref mainTakeMeasurement.
+*
+* @param channel channel of the first adc, 0 to SCAN_GROUPS - 1.
+* @param slot measurement of the group to store, 0 730nm, 1 850nm, 2 dark.
+* @return measurement of the first adc's channel, the others are stored in
+*         \ref groupLevel
+*/
+adcReturn_t mainTakeGroup(uint8_t channel, uint8_t slot) {
+#if FNIR_ADC_CHIPS > 1
+    adcReturn_t adcReturnValue;
+    uint8_t chip;
+
+    // Channel in the same place of every adc's block
+    for (chip = 0; chip < FNIR_ADC_CHIPS; chip++) {
+        mainStartConversion(chip, mainChannelWord(channel + (chip * SCAN_GROUPS), AUTO_CALIBRATE));
+    }
+
+    adcReturnValue = mainFinishConversion(0);
+
+    for (chip = 1; chip < FNIR_ADC_CHIPS; chip++) {
+        groupLevel[chip][slot] = mainFinishConversion(chip);
+    }
+
+    return (adcReturnValue);
+#else
+    return (mainTakeMeasurement(channel));
+#endif
+}
+
+/** Runs one conversion on an ADC input
+*
+* Blocks until result is returned.
+*
+* @param chip adc to convert on.
+* @param adcWord command word selecting input, speed and gain, see
+*        \ref mainChannelWord.
+* @return measurement data
+*/
+adcReturn_t mainConvert(uint8_t chip, uint16_t adcWord) {
+    mainStartConversion(chip, adcWord);
+
+    return (mainFinishConversion(chip));
+}
+
+/** Commands an ADC to begin a conversion
+*
+* @param chip adc to convert on.
+* @param adcWord command word selecting input, speed and gain, see
+*        \ref mainChannelWord.
+*/
+void mainStartConversion(uint8_t chip, uint16_t adcWord) {
+    PROF_BEGIN(PROF_ADC_SELECT);
+    (void) adcSelectWord(chip, adcWord);
+    PROF_END(PROF_ADC_SELECT);
+}
+
+/** Waits for an ADC conversion to complete and reads it
+*
+* The adc is held selected while waiting so its SDO line signals end of
+* conversion.
+*
+* @param chip adc converting.
+* @return measurement data
+*/
+adcReturn_t mainFinishConversion(uint8_t chip) {
+    adcReturn_t adcReturnValue;
+
+#ifdef FNIR_FLASH_ENABLE
+    // Bus is free until the adc is selected
+    flashService();
+#endif
+
+    adcWaitSelect(chip, 1);
+
+#ifdef FNIR_SLEEP_ENABLE
+    BOARD_ADC_EOC_INT_ENABLE();
+#endif
+
+    PROF_BEGIN(PROF_EOC_WAIT);
+    while (BOARD_ADC_BUSY()) { // Wait for conversion complete
+        schedYield();
+        schedSleep();
+    }
+    PROF_END(PROF_EOC_WAIT);
+
+#ifdef FNIR_SLEEP_ENABLE
+    BOARD_ADC_EOC_INT_DISABLE();
+    schedMarkServiced();
+#endif
+
+    adcWaitSelect(chip, 0);
+
+    // Get return value while commanding ADC to shutdown
+    PROF_BEGIN(PROF_ADC_SELECT);
+    adcReturnValue = adcSelect(chip,           // Adc to read
+                               DISABLE,        // Disable adc
+                               NULL_CH,        // Null channel
+                               NULL_REJECTION, // Null frequency rejection
+                               NULL_SPEED,     // Null conversion speed
+                               NULL_GAIN);     // Null signal gain
+    PROF_END(PROF_ADC_SELECT);
+
+    return (adcReturnValue);
+}
+
+/** Hands a scanned channel over to the process task
+*
+* @param channel channel measured
+* @param adcReturnValue array of 730nm, 850nm and dark measurements
+* @param darkLevel separate dark levels to subtract from 730nm and 850nm
+*                  results, or NULL to subtract the dark measurement
+*/
+void mainPostResult(uint8_t channel, adcReturn_t *adcReturnValue, int32_t *darkLevel) {
+    uint8_t wavelength;
+
+    pendingResult.channel = channel;
+
+    for (wavelength = 0; wavelength < 3; wavelength++) {
+        pendingResult.level[wavelength] = adcReturnValue[wavelength];
+    }
+
+#ifdef FNIR_BRACKET_ENABLE
+    pendingResult.bracketed = (darkLevel != NULL);
+
+    if (darkLevel != NULL) {
+        pendingResult.darkLevel[0] = darkLevel[0];
+        pendingResult.darkLevel[1] = darkLevel[1];
+    }
+#endif
+
+#ifdef FNIR_JITTER_ENABLE
+    jitterRecord(channel);
+#endif
+
+    resultPending = 1;
+    schedPost(SCHED_TASK_PROCESS);
+}
+
+/** Runs on-device processing stages over one channel's measurements
+*
+* Range flags of the three measurements are copied into the result flags.
+* With a valid calibration table the detector offset and gain error are
+* first removed from every measurement. The dark result is subtracted from
+* both wavelengths and, with LED intensity control built in, the dark
+* subtracted levels are recorded for the control loop before the calibrated
+* LED normalisation is applied. Temperature drift is removed when temperature monitoring
+* is enabled, and the corrected samples are passed through the artifact detector, which only sets flags, and the
+* signal quality statistics, which report once per window. With the filter
+* bank enabled the corrected samples are then filtered and possibly held
+* back by decimation. Corrections are made on full 32 bit levels; the
+* artifact, statistics, intensity and filter stages work on Q15 samples
+* taken from them by \ref mainSampleLevels, which flags any level it has to
+* clamp.
+*
+* Without any correcting stage enabled the raw results are reported
+* unchanged. Once a calibration table, dark tracking, temperature correction,
+* filtering or the bracketed sequence is enabled the corrected levels are reported in place
+* of the raw wavelength results, at full range unless the filter bank has
+* replaced them with its Q15 output, and with dark tracking the dark result
+* is the tracked estimate.
+*
+* @param channel channel measured
+* @param adcReturnValue array of 730nm, 850nm and dark measurements
+* @param darkLevel separate dark levels to subtract from 730nm and 850nm
+*                  results, or NULL to subtract the dark measurement
+*/
+void mainProcessResult(uint8_t channel, adcReturn_t *adcReturnValue, int32_t *darkLevel) {
+    int32_t result[3];
+    int32_t darkCorrected[2];
+#if defined(FNIR_LED_PWM_ENABLE) || defined(FNIR_ARTIFACT_ENABLE) || defined(FNIR_STATS_ENABLE) || defined(FNIR_IIR_ENABLE)
+    int16_t sample[2];
+#endif
+#ifdef FNIR_LED_PWM_ENABLE
+    uint8_t sampleFlags;
+#endif
+    uint8_t wavelength;
+    uint8_t flags = 0;
+    uint8_t reportCorrected = 0;
+#ifdef FNIR_STATS_ENABLE
+    statsRecord_t statsRecord;
+#endif
+#ifdef FNIR_CAL_ENABLE
+    int32_t calibratedDark[2];
+    int16_t offset;
+    uint16_t gain;
+#endif
+
+    for (wavelength = 0; wavelength < 3; wavelength++) {
+        result[wavelength] = adcReturnValue[wavelength].returnValue;
+
+        if (adcReturnValue[wavelength].overRange) {
+            flags |= (RESULT_FLAG_OVER_730<<wavelength);
+        }
+
+        if (adcReturnValue[wavelength].underRange) {
+            flags |= (RESULT_FLAG_UNDER_730<<wavelength);
+        }
+    }
+
+#ifdef FNIR_CAL_ENABLE
+    // Remove detector offset and unity gain error from every conversion
+    if (calIsValid()) {
+        offset = calDarkOffset(mainChannelDetector(channel));
+        gain = calGainFactor(pgm_read_byte(&mainMontageGain[channel]));
+
+        for (wavelength = 0; wavelength < 3; wavelength++) {
+            result[wavelength] = calScale(result[wavelength] - offset, gain);
+        }
+
+        if (darkLevel != NULL) {
+            calibratedDark[0] = calScale(darkLevel[0] - offset, gain);
+            calibratedDark[1] = calScale(darkLevel[1] - offset, gain);
+            darkLevel = calibratedDark;
+        }
+
+        reportCorrected = 1;
+    }
+#endif
+
+    if (darkLevel == NULL) {
+        darkCorrected[0] = result[0] - result[2];
+        darkCorrected[1] = result[1] - result[2];
+    } else {
+        darkCorrected[0] = result[0] - darkLevel[0];
+        darkCorrected[1] = result[1] - darkLevel[1];
+        reportCorrected = 1;
+    }
+
+#ifdef FNIR_DARK_TRACK_ENABLE
+    if (darkIsEnabled()) {
+        reportCorrected = 1;
+    }
+#endif
+
+#ifdef FNIR_LED_PWM_ENABLE
+    // Intensity loop steers on the dark subtracted level actually reaching the adc
+    sampleFlags = mainSampleLevels(darkCorrected, sample, 2);
+    ledObserve(mainChannelSource(channel), sample,
+               ((flags | sampleFlags) & (RESULT_FLAG_OVER_730|RESULT_FLAG_OVER_850))>>1);
+#endif
+
+#ifdef FNIR_CAL_ENABLE
+    // Normalise LED output after the intensity loop has seen the real level
+    if (calIsValid()) {
+        darkCorrected[0] = calScale(darkCorrected[0], calLedFactor(mainChannelSource(channel), 0));
+        darkCorrected[1] = calScale(darkCorrected[1], calLedFactor(mainChannelSource(channel), 1));
+    }
+#endif
+
+#ifdef FNIR_TEMP_ENABLE
+    if (tempIsEnabled()) {
+        tempCorrect(channel, darkCorrected);
+        reportCorrected = 1;
+    }
+#endif
+
+#if defined(FNIR_ARTIFACT_ENABLE) || defined(FNIR_STATS_ENABLE) || defined(FNIR_IIR_ENABLE)
+    flags |= mainSampleLevels(darkCorrected, sample, 2);
+#endif
+
+#ifdef FNIR_ARTIFACT_ENABLE
+    if (artifactIsEnabled() && artifactDetect(channel, sample)) {
+        flags |= RESULT_FLAG_ARTIFACT;
+    }
+#endif
+
+#ifdef FNIR_STATS_ENABLE
+    // Dark beyond Q15 is out of adc range, already flagged above
+    if (statsIsEnabled() && statsUpdate(channel, sample, q15Saturate(result[2]), &statsRecord)) {
+        mainReportStats(channel, &statsRecord);
+    }
+#endif
+
+#ifdef FNIR_IIR_ENABLE
+    if (iirIsEnabled()) {
+        // Skip reporting frames removed by decimation
+        if (!iirProcess(channel, sample)) {
+            return;
+        }
+
+        darkCorrected[0] = sample[0];
+        darkCorrected[1] = sample[1];
+        reportCorrected = 1;
+    }
+#endif
+
+    if (reportCorrected) {
+        result[0] = darkCorrected[0];
+        result[1] = darkCorrected[1];
+    }
+
+    PROF_BEGIN(PROF_REPORT);
+    mainReportResult(channel, result, flags);
+    PROF_END(PROF_REPORT);
+}
+
+/** Takes Q15 processing samples from full range levels
+*
+* Samples are adc LSBs, so 1.0 is 32768 LSBs, the adc's 0.5 VREF/gain full
+* scale. A dark subtracted level can reach twice that; such a level is
+* clamped to the Q15 range and flagged rather than silently flattened.
+*
+* @param level  levels in adc LSBs, 730nm first
+* @param sample array of count Q15 samples to fill
+* @param count  number of levels
+* @return RESULT_FLAG_OVER_* and RESULT_FLAG_UNDER_* bits of clamped levels
+*/
+uint8_t mainSampleLevels(int32_t *level, int16_t *sample, uint8_t count) {
+    uint8_t wavelength;
+    uint8_t flags = 0;
+
+    for (wavelength = 0; wavelength < count; wavelength++) {
+        sample[wavelength] = q15Saturate(level[wavelength]);
+
+        if (level[wavelength] > INT16_MAX) {
+            flags |= (RESULT_FLAG_OVER_730<<wavelength);
+        } else if (level[wavelength] < INT16_MIN) {
+            flags |= (RESULT_FLAG_UNDER_730<<wavelength);
+        }
+    }
+
+    return (flags);
+}
+
+/** Reports CVS dataset of measurements over USB
+*
+* TODO: calculate estimated oxy content from received values
+*
+* With \c FNIR_USB_BUFFER_ENABLE every data line carries a sequence number
+* and lines produced while the host is disconnected, or while earlier lines
+* are still waiting, are held in \ref recordBuffer and sent in order once it
+* reconnects. When the buffer is full the oldest line is dropped, leaving a
+* gap in the sequence numbers.
+*
+* With \c FNIR_FLASH_ENABLE every line is also queued for a running dataflash
+* recording, whether or not the host is connected.
+*
+* @param channel channel measured
+* @param result array of 730nm, 850nm and dark results from specific channel
+* @param flags RESULT_FLAG_* bits describing the result
+*/
+void mainReportResult(uint8_t channel, int32_t *result, uint8_t flags) {
+#ifdef FNIR_USB_BUFFER_ENABLE
+    fnir_record_t record;
+    uint8_t wavelength;
+#endif
+#ifdef FNIR_FLASH_ENABLE
+    int16_t frameResult[3];
+
+    // Frames hold 16 bit results, a clamped one is flagged
+    flashLog(channel, flags | mainSampleLevels(result, frameResult, 3), frameResult);
+#endif
+
+#ifdef FNIR_PROFILE_ENABLE
+    if (firstFrameTime == 0) {
+        firstFrameTime = schedMillis();
+    }
+#endif
+
+#ifdef FNIR_USB_BUFFER_ENABLE
+
+    record.sequence = recordSequence++;
+    record.channel = channel;
+    record.flags = flags;
+
+    for (wavelength = 0; wavelength < 3; wavelength++) {
+        record.result[wavelength] = result[wavelength];
+    }
+
+    if ((USBSystemState == USB_CONNECTED) && (recordCount == 0)) {
+        mainSendRecord(&record);
+        return;
+    }
+
+    // Hold line behind earlier ones, dropping oldest if full
+    if (recordCount == FNIR_USB_BUFFER_RECORDS) {
+        recordHead = (recordHead + 1) % FNIR_USB_BUFFER_RECORDS;
+        recordCount--;
+#ifdef FNIR_USB_STATS_ENABLE
+        usbStatFrameDropped();
+#endif
+    }
+
+#ifdef FNIR_USB_STATS_ENABLE
+    usbStatFrameDelayed();
+#endif
+
+    recordBuffer[(recordHead + recordCount) % FNIR_USB_BUFFER_RECORDS] = record;
+    recordCount++;
+#else
+    uint16_t estimatedOxyContent = 0; // Oxy column not yet computed, always 0
+
+#ifdef FNIR_USB_STATS_ENABLE
+    if (USBSystemState != USB_CONNECTED) {
+        usbStatFrameDropped();
+        return;
+    }
+#endif
+
+    fprintf(&USBSerialStream, "%d,%ld,%ld,%ld,%d,%d\r\n", // CSV string
+            ((uint16_t) channel),                         // Reported channel
+            result[0],                                    // 730nm result
+            result[1],                                    // 850nm result
+            result[2],                                    // Dark result
+            estimatedOxyContent,                          // Calculated oxy value
+            flags);                                       // Result flags
+#endif
+}
+
+#ifdef FNIR_USB_BUFFER_ENABLE
+/** Sends one data line over USB
+*
+* Same CSV line as without buffering with the sequence number appended.
+*
+* @param record data line to send
+*/
+void mainSendRecord(fnir_record_t *record) {
+    uint16_t estimatedOxyContent = 0; // Oxy column not yet computed, always 0
+
+    fprintf(&USBSerialStream, "%d,%ld,%ld,%ld,%d,%d,%u\r\n", // CSV string
+            ((uint16_t) record->channel),                    // Reported channel
+            record->result[0],                               // 730nm result
+            record->result[1],                               // 850nm result
+            record->result[2],                               // Dark result
+            estimatedOxyContent,                             // Calculated oxy value
+            record->flags,                                   // Result flags
+            record->sequence);                               // Sequence number
+}
+
+/** Sends oldest held data line
+*
+* Called from the USB task while connected, one line per call so buffered
+* lines drain without holding up the scheduler.
+*/
+void mainFlushRecords(void) {
+    if (recordCount == 0) {
+        return;
+    }
+
+    mainSendRecord(&recordBuffer[recordHead]);
+    recordHead = (recordHead + 1) % FNIR_USB_BUFFER_RECORDS;
+    recordCount--;
+}
+#endif
+
+/** Reports worst case task run times over USB
+*
+* Sent as one CSV line per task tagged with a leading \c K, carrying the
+* task number in priority order and its longest run in microseconds. With
+* sleep built in a last \c K,W line carries the worst latency from adc end
+* of conversion to its readout starting, in microseconds.
+*/
+void mainReportSchedule(void) {
+    uint8_t task;
+
+    for (task = 0; task < SCHED_TASKS; task++) {
+        fprintf(&USBSerialStream, "K,%d,%lu\r\n",        // CSV string
+                ((uint16_t) task),                      // Task number
+                schedWorst(task));                      // Worst case run time
+    }
+
+#ifdef FNIR_SLEEP_ENABLE
+    fprintf(&USBSerialStream, "K,W,%lu\r\n",            // CSV string
+            schedWorstLatency());                       // Worst wake to work latency
+#endif
+}
+
+#ifdef FNIR_PROF_ENABLE
+/** Reports pipeline stage profiles over USB
+*
+* Sent as one CSV line per stage tagged with a leading \c P, carrying the
+* stage number in \ref profStage_t order, its shortest, longest and mean
+* run in CPU cycles and the number of runs averaged.
+*/
+void mainReportProfiling(void) {
+    profRecord_t record;
+    uint8_t stage;
+
+    for (stage = 0; stage < PROF_STAGES; stage++) {
+        profRead(stage, &record);
+        fprintf(&USBSerialStream, "P,%d,%lu,%lu,%lu,%u\r\n", // CSV string
+                ((uint16_t) stage),                         // Stage number
+                record.minimum,                             // Shortest run
+                record.maximum,                             // Longest run
+                record.mean,                                // Mean run
+                record.count);                              // Runs averaged
+    }
+}
+#endif
+
+#ifdef FNIR_JITTER_ENABLE
+/** Reports timing jitter histograms over USB
+*
+* Sent as one CSV line per histogram tagged with a leading \c J, carrying the
+* histogram number in \ref jitterHistogram_t order, the mean frame period in
+* microseconds and the count of every bin, shortest deviation first.
+*/
+void mainReportJitter(void) {
+    uint8_t histogram;
+    uint8_t bin;
+
+    for (histogram = 0; histogram < JITTER_HISTOGRAMS; histogram++) {
+        fprintf(&USBSerialStream, "J,%d,%lu", ((uint16_t) histogram), jitterMeanPeriod());
+
+        for (bin = 0; bin < JITTER_BINS; bin++) {
+            fprintf(&USBSerialStream, ",%u", jitterBin(histogram, bin));
+        }
+
+        fprintf(&USBSerialStream, "\r\n");
+    }
+}
+#endif
+
+#ifdef FNIR_USB_STATS_ENABLE
+/** Reports USB transport counters over USB
+*
+* Sent as a CSV line tagged with a leading \c U. Counters are read before
+* the line is written, so it does not count itself.
+*/
+void mainReportUsbStat(void) {
+    usbStat_t stat;
+
+    usbStatRead(&stat);
+    fprintf(&USBSerialStream, "U,%lu,%u,%u,%u,%lu,%u,%u,%u\r\n", // CSV string
+            stat.bytes,                                       // Bytes written
+            stat.packets,                                     // Packets sent
+            stat.shortPackets,                                // Short packets
+            stat.waits,                                       // Blocked writes
+            stat.blockedCycles,                               // Cycles blocked
+            stat.droppedBytes,                                // Bytes lost
+            stat.framesDelayed,                               // Data lines held back
+            stat.framesDropped);                              // Data lines lost
+}
+#endif
+
+#ifdef FNIR_MEM_ENABLE
+/** Reports RAM headroom over USB
+*
+* Sent as a CSV line tagged with a leading \c M, carrying bytes of static
+* data, deepest stack use since reset, bytes never touched between them and
+* bytes free below the current stack pointer.
+*/
+void mainReportMemory(void) {
+    memUsage_t usage;
+
+    memMeasure(&usage);
+    fprintf(&USBSerialStream, "M,%u,%u,%u,%u\r\n", // CSV string
+            usage.staticSize,                       // Static data
+            usage.stackPeak,                        // Deepest stack use
+            usage.unused,                           // Never touched
+            usage.free);                            // Free now
+}
+#endif
+
+#ifdef FNIR_PROFILE_ENABLE
+/** Reports session profile over USB
+*
+* Sends one line per stored command tagged with \c E,L followed by a CSV line
+* tagged with \c E carrying whether the profile is valid, its flags, its
+* length in bytes and the time from power up to the first data line in
+* milliseconds, 0 if none has been reported yet.
+*/
+void mainReportProfile(void) {
+    char line[COMMAND_BUFFER_SIZE];
+    uint16_t offset = 0;
+
+    while (profileReadLine(&offset, line, sizeof(line)) == 0) {
+        fprintf(&USBSerialStream, "E,L,%s\r\n", line);
+    }
+
+    fprintf(&USBSerialStream, "E,%d,%d,%u,%lu\r\n",        // CSV string
+            ((uint16_t) profileIsValid()),              // Profile valid
+            ((uint16_t) profileFlags()),                // Profile flags
+            profileLength(),                            // Bytes of command lines
+            firstFrameTime);                            // Power up to first data line
+}
+#endif
+
+#ifdef FNIR_STATS_ENABLE
+/** Reports signal quality record of one channel over USB
+*
+* Sent as a CSV line tagged with a leading \c Q so it can be told apart from
+* measurement lines.
+*
+* @param channel channel the record describes
+* @param record statistics over the last window
+*/
+void mainReportStats(uint8_t channel, statsRecord_t *record) {
+    fprintf(&USBSerialStream, "Q,%d,%d,%u,%d,%u,%d\r\n", // CSV string
+            ((uint16_t) channel),                        // Reported channel
+            record->mean[0],                             // 730nm mean
+            record->variance[0],                         // 730nm variance
+            record->mean[1],                             // 850nm mean
+            record->variance[1],                         // 850nm variance
+            record->dark);                               // Dark mean
+}
+#endif
+
+#ifdef FNIR_TEMP_ENABLE
+/** Reports last internal temperature reading over USB
+*
+* Sent as a CSV line tagged with a leading \c T, carrying the raw reading and
+* the reference drift is corrected against.
+*/
+void mainReportTemperature(void) {
+    fprintf(&USBSerialStream, "T,%d,%d\r\n", // CSV string
+            tempRead(),                         // Last temperature reading
+            tempReference());                   // Drift reference
+}
+#endif
+
+#ifdef FNIR_SETTLE_ENABLE
+/** Reports settle delay table over USB
+*
+* Sent as one CSV line per source tagged with a leading \c L, carrying the
+* 730nm and 850nm delays in microseconds.
+*/
+void mainReportSettle(void) {
+    uint8_t source;
+
+    for (source = 0; source < FNIR_SOURCES; source++) {
+        fprintf(&USBSerialStream, "L,%d,%u,%u\r\n",    // CSV string
+                ((uint16_t) source),                    // LED source
+                settleGet(source, 0),                   // 730nm delay
+                settleGet(source, 1));                  // 850nm delay
+    }
+}
+#endif
+
+#ifdef FNIR_LED_PWM_ENABLE
+/** Reports LED intensity table over USB
+*
+* Sent as one CSV line per source tagged with a leading \c I, carrying the
+* 730nm and 850nm intensities out of 255. Sent whenever the control loop
+* changes an intensity, so the host can rescale results measured after it.
+*/
+void mainReportIntensity(void) {
+    uint8_t source;
+
+    for (source = 0; source < FNIR_SOURCES; source++) {
+        fprintf(&USBSerialStream, "I,%d,%d,%d\r\n",      // CSV string
+                ((uint16_t) source),                    // LED source
+                ((uint16_t) ledIntensity(source, 0)),   // 730nm intensity
+                ((uint16_t) ledIntensity(source, 1)));  // 850nm intensity
+    }
+}
+#endif
+
+#ifdef FNIR_SPEED_ENABLE
+/** Reports double speed offsets over USB
+*
+* Sent as one CSV line per detector tagged with a leading \c C, carrying the
+* offset subtracted from its double speed readings in adc LSBs.
+*/
+void mainReportSpeed(void) {
+    uint8_t detector;
+
+    for (detector = 0; detector < SPEED_DETECTORS; detector++) {
+        fprintf(&USBSerialStream, "C,%d,%d\r\n",         // CSV string
+                ((uint16_t) detector),                  // Detector (adc input)
+                speedOffset(detector));                 // Double speed offset
+    }
+}
+#endif
+
+#ifdef FNIR_SLEEP_ENABLE
+/** Wakes CPU when adc signals end of conversion
+*
+* Only enabled while \ref mainConvert waits, the chip is selected and the
+* SPI bus is quiet, so the only edge seen is SDO falling at end of
+* conversion.
+*/
+ISR(BOARD_ADC_EOC_vect) {
+    BOARD_ADC_EOC_INT_DISABLE();
+    schedMark();
+}
+#endif
+
+/** Event handler for the library USB Connection event. 
+*
+* Bus power has been detected, the host still has to enumerate the system
+* before data can be sent.
+* 
+* @return This function does not return a value.
+*/
+void EVENT_USB_Device_Connect(void) {
+}
+
+/** Event handler for the library USB Disconnection event.
+*
+* Holds back output until the host configures the system again, the scan
+* carries on.
+*
+* @return This function does not return a value.
+*/
+void EVENT_USB_Device_Disconnect(void) {
+    USBSystemState = USB_IDLE;
+}
+
+/** Event handler for the library USB Configuration Changed event.
+*
+* Host has enumerated the system, so once the CDC endpoints are configured
+* output resumes.
+*
+* @return This function does not return a value.
+*/
+void EVENT_USB_Device_ConfigurationChanged(void) {
+    if (CDC_Device_ConfigureEndpoints(&VirtualSerial_CDC_Interface)) {
+        USBSystemState = USB_CONNECTED;
+    }
+}
+
+#ifdef FNIR_PROFILE_ENABLE
+/** Event handler for the library CDC control line state change event.
+*
+* Starts streaming when the host opens the line and the session profile
+* asks for autostart. Runs from the USB interrupt, only the scan state and
+* the acquisition task's ready flag are touched.
+*
+* @param CDCInterfaceInfo CDC interface whose line state changed.
+* @return This function does not return a value.
+*/
+void EVENT_CDC_Device_ControLineStateChanged(USB_ClassInfo_CDC_Device_t *const CDCInterfaceInfo) {
+    if ((CDCInterfaceInfo->State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)
+        && (profileFlags() & PROFILE_FLAG_AUTOSTART)
+        && (fnirModeState == FNIR_STOP)) {
+        fnirModeState = FNIR_IDLE;
+        schedPost(SCHED_TASK_ACQUIRE);
+    }
 }
+#endif
 
 /** Event handler for the library USB Control Request reception event.
 *
@@ -0,0 +1,54 @@
+/** @file mem.c
+* @brief RAM headroom measurement
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_MEM_ENABLE
+
+extern uint8_t __data_start; // Start of static data, from linker
+extern uint8_t __heap_start; // End of static data, from linker
+
+void memPaint(void) __attribute__ ((naked, used, section (".init1")));
+
+/** Fills free RAM with \ref MEM_PAINT
+*
+* Runs in .init1, before the stack pointer is set up and before any static
+* data is copied, so only registers are used.
+*/
+void memPaint(void) {
+    __asm__ __volatile__ (
+        "    ldi r30, lo8(__heap_start)\n"
+        "    ldi r31, hi8(__heap_start)\n"
+        "    ldi r24, %0\n"
+        "    ldi r25, hi8(%1)\n"
+        "1:  st Z+, r24\n"
+        "    cpi r30, lo8(%1)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n"
+        :
+        : "i" (MEM_PAINT), "i" (RAMEND)
+        : "r24", "r25", "r30", "r31", "memory");
+}
+
+void memMeasure(memUsage_t *usage) {
+    uint8_t *address;
+    uint8_t local;
+
+    address = &__heap_start;
+
+    // Lowest byte ever written by stack ends the paint
+    while ((address <= (uint8_t *) RAMEND) && (*address == MEM_PAINT)) {
+        address++;
+    }
+
+    usage->staticSize = (uint16_t) (&__heap_start - &__data_start);
+    usage->unused = (uint16_t) (address - &__heap_start);
+    usage->stackPeak = (uint16_t) (((uint8_t *) RAMEND) - address) + 1;
+    usage->free = (uint16_t) (&local - &__heap_start);
+}
+
+#endif
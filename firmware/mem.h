@@ -0,0 +1,37 @@
+/** @file mem.h
+* @brief RAM headroom measurement
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional stack painting, built in with \c FNIR_MEM_ENABLE. Before the C
+* runtime starts, every byte from the end of static data (\c __heap_start) to
+* the stack pointer is filled with \ref MEM_PAINT. The stack grows down
+* through that region and the heap is unused, so the lowest byte still
+* holding the paint marks the deepest the stack has ever reached. Scanning up
+* from the end of static data gives the bytes never touched since reset, the
+* headroom left for new buffers once every feature in use has been exercised.
+*
+* The paint is a best guess of untouched RAM: a stack frame that happens to
+* hold \ref MEM_PAINT at its lowest byte would be counted as unused, so the
+* figure may read a few bytes high. No RAM is taken.
+*/
+
+#define MEM_PAINT 0xC5 /**< Fill byte of unused RAM */
+
+/** RAM usage figures.
+*
+*/
+typedef struct {
+    uint16_t staticSize; /**< Bytes of initialized and zeroed data */
+    uint16_t stackPeak; /**< Deepest stack use since reset, bytes */
+    uint16_t unused; /**< Bytes between static data and deepest stack, never touched */
+    uint16_t free; /**< Bytes between static data and current stack pointer */
+} memUsage_t;
+
+/** Measures RAM usage.
+*
+* Scans painted region, taking time proportional to the bytes never used.
+*
+* @param usage Receives usage figures.
+*/
+extern void memMeasure(memUsage_t *usage);
@@ -0,0 +1,71 @@
+/** @file prof.c
+* @brief Pipeline stage profiling
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_PROF_ENABLE
+
+static uint32_t profStart[PROF_STAGES]; // Time base at stage start
+static uint32_t profMinimum[PROF_STAGES];
+static uint32_t profMaximum[PROF_STAGES];
+static uint32_t profTotal[PROF_STAGES];
+static uint16_t profCount[PROF_STAGES];
+
+void profInit(void) {
+    uint8_t stage;
+
+    for (stage = 0; stage < PROF_STAGES; stage++) {
+        profMinimum[stage] = 0xFFFFFFFFUL;
+        profMaximum[stage] = 0;
+        profTotal[stage] = 0;
+        profCount[stage] = 0;
+    }
+}
+
+void profBegin(profStage_t stage) {
+    profStart[stage] = schedNow();
+}
+
+void profEnd(profStage_t stage) {
+    uint32_t elapsed;
+
+    // Modulo arithmetic, valid across time base wrap
+    elapsed = schedNow() - profStart[stage];
+
+    if (elapsed < profMinimum[stage]) {
+        profMinimum[stage] = elapsed;
+    }
+
+    if (elapsed > profMaximum[stage]) {
+        profMaximum[stage] = elapsed;
+    }
+
+    // Keep averaging once either sum would overflow, weighting halves
+    if ((profCount[stage] == 0xFFFF) || (profTotal[stage] > (0xFFFFFFFFUL - elapsed))) {
+        profTotal[stage] >>= 1;
+        profCount[stage] >>= 1;
+    }
+
+    profTotal[stage] += elapsed;
+    profCount[stage]++;
+}
+
+void profRead(profStage_t stage, profRecord_t *record) {
+    if ((stage >= PROF_STAGES) || (profCount[stage] == 0)) {
+        record->minimum = 0;
+        record->maximum = 0;
+        record->mean = 0;
+        record->count = 0;
+        return;
+    }
+
+    record->minimum = profMinimum[stage];
+    record->maximum = profMaximum[stage];
+    record->mean = profTotal[stage]/profCount[stage];
+    record->count = profCount[stage];
+}
+
+#endif
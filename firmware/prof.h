@@ -0,0 +1,69 @@
+/** @file prof.h
+* @brief Pipeline stage profiling
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional timing of the firmware's busiest stages, built in with
+* \c FNIR_PROF_ENABLE. Each stage is bracketed with \ref PROF_BEGIN and
+* \ref PROF_END, which read the scheduler's cycle time base (1ms tick times
+* 16000 plus timer 1 at F_CPU, at 16MHz) and fold the elapsed time into the
+* stage's shortest, longest and mean run. Results resolve to single CPU
+* cycles, less the few cycles the macros themselves take. Without the option
+* the macros expand to nothing. State is 18 bytes per stage.
+*/
+
+/** Profiled stages.
+*
+*/
+typedef enum {
+    PROF_ADC_SELECT, /**< Adc command and readout transfers */
+    PROF_EOC_WAIT, /**< Wait for adc end of conversion */
+    PROF_LED_CONTROL, /**< Source LED switching */
+    PROF_REPORT, /**< Formatting and queueing a data line */
+    PROF_CDC_TASK, /**< CDC class servicing */
+    PROF_USB_TASK, /**< LUFA device servicing */
+    PROF_STAGES
+} profStage_t;
+
+#ifdef FNIR_PROF_ENABLE
+#define PROF_BEGIN(stage) profBegin(stage) /**< Marks start of a stage */
+#define PROF_END(stage) profEnd(stage) /**< Marks end of a stage and records its time */
+#else
+#define PROF_BEGIN(stage)
+#define PROF_END(stage)
+#endif
+
+/** Profile of one stage.
+*
+*/
+typedef struct {
+    uint32_t minimum; /**< Shortest run, cycles */
+    uint32_t maximum; /**< Longest run, cycles */
+    uint32_t mean; /**< Mean run, cycles */
+    uint16_t count; /**< Runs averaged */
+} profRecord_t;
+
+/** Clears every stage profile.
+*
+* @return Function does not return a value.
+*/
+extern void profInit(void);
+
+/** Marks start of a stage.
+*
+* @param stage Stage starting.
+*/
+extern void profBegin(profStage_t stage);
+
+/** Marks end of a stage and records its time.
+*
+* @param stage Stage ending, must have been started with \ref profBegin.
+*/
+extern void profEnd(profStage_t stage);
+
+/** Reads profile of one stage.
+*
+* @param stage  Stage to read.
+* @param record Receives the stage's profile, all zero if it has not run.
+*/
+extern void profRead(profStage_t stage, profRecord_t *record);
@@ -0,0 +1,148 @@
+/** @file profile.c
+* @brief EEPROM session profile
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_PROFILE_ENABLE
+
+/** Profile header stored ahead of command lines.
+*
+*/
+typedef struct {
+    uint8_t version; /**< PROFILE_VERSION, erased EEPROM reads 0xFF */
+    uint8_t flags; /**< PROFILE_FLAG_* bits */
+    uint16_t length; /**< Bytes of command lines */
+    uint16_t crc; /**< CRC-16 over flags, length and lines */
+} profileHeader_t;
+
+static profileHeader_t EEMEM profileStoredHeader;
+static char EEMEM profileStoredText[FNIR_PROFILE_SIZE];
+
+static uint16_t profileTextLength; // Length of stored or partly built profile
+static uint8_t profileValid;
+static uint8_t profileStoredFlags;
+
+static uint16_t profileCrc(uint8_t flags, uint16_t length);
+
+void profileInit(void) {
+    profileHeader_t header;
+
+    eeprom_read_block(&header, &profileStoredHeader, sizeof(header));
+
+    profileValid = ((header.version == PROFILE_VERSION)
+                    && (header.length <= FNIR_PROFILE_SIZE)
+                    && (profileCrc(header.flags, header.length) == header.crc));
+
+    if (profileValid) {
+        profileTextLength = header.length;
+        profileStoredFlags = header.flags;
+    } else {
+        profileTextLength = 0;
+        profileStoredFlags = 0;
+    }
+}
+
+uint8_t profileIsValid(void) {
+    return (profileValid);
+}
+
+uint8_t profileFlags(void) {
+    return (profileStoredFlags);
+}
+
+uint16_t profileLength(void) {
+    return (profileTextLength);
+}
+
+void profileClear(void) {
+    eeprom_update_byte(&profileStoredHeader.version, 0xFF);
+    profileTextLength = 0;
+    profileValid = 0;
+    profileStoredFlags = 0;
+}
+
+uint8_t profileAppend(const char *line) {
+    uint16_t length;
+
+    length = strlen(line) + 1;
+
+    if ((profileTextLength + length) > FNIR_PROFILE_SIZE) {
+        return (1);
+    }
+
+    // Appending changes the stored lines, profile must be committed again
+    if (profileValid) {
+        eeprom_update_byte(&profileStoredHeader.version, 0xFF);
+        profileValid = 0;
+    }
+
+    eeprom_update_block(line, &profileStoredText[profileTextLength], length);
+    profileTextLength += length;
+
+    return (0);
+}
+
+void profileCommit(uint8_t flags) {
+    profileHeader_t header;
+
+    header.version = PROFILE_VERSION;
+    header.flags = flags;
+    header.length = profileTextLength;
+    header.crc = profileCrc(flags, profileTextLength);
+
+    eeprom_update_block(&header, &profileStoredHeader, sizeof(header));
+
+    profileValid = 1;
+    profileStoredFlags = flags;
+}
+
+uint8_t profileReadLine(uint16_t *offset, char *line, uint8_t size) {
+    uint8_t index = 0;
+    char received;
+
+    if (*offset >= profileTextLength) {
+        return (1);
+    }
+
+    do {
+        received = eeprom_read_byte((const uint8_t *) &profileStoredText[(*offset)++]);
+
+        if (index < (size - 1)) {
+            line[index++] = received;
+        }
+    } while ((received != '\0') && (*offset < profileTextLength));
+
+    line[index] = '\0';
+
+    return (0);
+}
+
+/** Computes CRC of profile contents
+*
+* @param flags Flags stored with profile.
+* @param length Bytes of command lines to cover.
+* @return CRC-16 over flags, length and lines.
+*/
+static uint16_t profileCrc(uint8_t flags, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    uint16_t offset;
+
+    if (length > FNIR_PROFILE_SIZE) {
+        return (0);
+    }
+
+    crc = _crc16_update(crc, flags);
+    crc = _crc16_update(crc, (uint8_t) length);
+    crc = _crc16_update(crc, (uint8_t) (length>>8));
+
+    for (offset = 0; offset < length; offset++) {
+        crc = _crc16_update(crc, eeprom_read_byte((const uint8_t *) &profileStoredText[offset]));
+    }
+
+    return (crc);
+}
+
+#endif
@@ -0,0 +1,78 @@
+/** @file profile.h
+* @brief EEPROM session profile
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional startup profile, built in with \c FNIR_PROFILE_ENABLE. Every
+* setting of the firmware is made through host commands, so the profile is
+* stored as the list of command lines a host would otherwise send after
+* power up: filter, artifact, statistics, dark, temperature, LED and mode
+* settings and their calibration values. Lines are appended by the host,
+* then committed with a header holding a format version and a CRC-16 over
+* the flags and lines. At power up a profile whose version and CRC match is
+* replayed through the command interpreter before the host connects.
+*
+* The header also holds an autostart flag. With it set streaming begins as
+* soon as the host opens the CDC line, without waiting for \c s.
+*/
+
+#ifndef FNIR_PROFILE_SIZE
+#define FNIR_PROFILE_SIZE ((BOARD_EEPROM_BYTES/2) - 32) /**< EEPROM bytes holding profile command lines, 224 on the ATmega16u2 */
+#endif
+
+#define PROFILE_VERSION 1 /**< Format version, profiles of other versions are ignored */
+#define PROFILE_FLAG_AUTOSTART (1<<0) /**< Profile flag, start streaming when line opens */
+
+/** Loads and checks profile header.
+*
+* @return Function does not return a value.
+*/
+extern void profileInit(void);
+
+/** Reports whether a committed profile with matching version and CRC exists.
+*
+* @return Nonzero when profile is valid.
+*/
+extern uint8_t profileIsValid(void);
+
+/** Returns profile flags.
+*
+* @return PROFILE_FLAG_* bits of the committed profile, 0 if none is valid.
+*/
+extern uint8_t profileFlags(void);
+
+/** Returns bytes of command lines stored.
+*
+* @return Length of profile text including line terminators.
+*/
+extern uint16_t profileLength(void);
+
+/** Discards profile.
+*
+* Marks the stored profile invalid and starts an empty one.
+*/
+extern void profileClear(void);
+
+/** Appends a command line to the profile being built.
+*
+* The profile stays invalid until \ref profileCommit is called.
+*
+* @param line Null terminated command line.
+* @return     Returns 0 on success, 1 if the line does not fit.
+*/
+extern uint8_t profileAppend(const char *line);
+
+/** Writes header making profile valid.
+*
+* @param flags PROFILE_FLAG_* bits to store.
+*/
+extern void profileCommit(uint8_t flags);
+
+/** Reads one command line of the profile.
+*
+* @param offset Offset of line to read, advanced to the next line.
+* @param line   Buffer receiving the null terminated line.
+* @param size   Size of buffer, longer lines are cut short.
+* @return       Returns 0 if a line was read, 1 past the last line.
+*/
+extern uint8_t profileReadLine(uint16_t *offset, char *line, uint8_t size);
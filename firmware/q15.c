@@ -0,0 +1,17 @@
+/** @file q15.c
+* @brief Q15 sample helpers
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+int16_t q15Saturate(int32_t value) {
+    if (value > INT16_MAX) {
+        return (INT16_MAX);
+    } else if (value < INT16_MIN) {
+        return (INT16_MIN);
+    }
+
+    return ((int16_t) value);
+}
@@ -0,0 +1,16 @@
+/** @file q15.h
+* @brief Q15 sample helpers
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Processing stages carry samples as 16 bit signed Q15 values in adc LSBs
+* and work in 32 bits, clamping back to 16 bits with \ref q15Saturate rather
+* than wrapping on overflow.
+*/
+
+/** Clamps a 32 bit value to the Q15 sample range.
+*
+* @param value Value to clamp.
+* @return      Value limited to INT16_MIN..INT16_MAX.
+*/
+extern int16_t q15Saturate(int32_t value);
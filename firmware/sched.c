@@ -0,0 +1,224 @@
+/** @file sched.c
+* @brief Cooperative task scheduler
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#define SCHED_TICK_COUNTS (F_CPU/1000UL) /**< Time base counts per 1ms tick, 16000 at 16MHz */
+
+static const schedTask_t *schedTable;
+static volatile uint8_t schedReady; // One bit per task
+static volatile uint32_t schedTicks; // Milliseconds since start
+static uint32_t schedWorstCounts[SCHED_TASKS];
+static uint8_t schedCurrent; // Task running, SCHED_TASKS when none
+static volatile uint8_t schedMarked;
+static volatile uint32_t schedMarkTime;
+static uint32_t schedWorstMark;
+
+static void schedDispatch(uint8_t task);
+static uint8_t schedYieldLimit(void);
+
+void schedInit(const schedTask_t *taskTable) {
+    schedTable = taskTable;
+    schedReady = 0;
+    schedTicks = 0;
+    schedCurrent = SCHED_TASKS;
+    schedMarked = 0;
+    schedClearWorst();
+#ifdef FNIR_SLEEP_ENABLE
+    set_sleep_mode(SLEEP_MODE_IDLE);
+#endif
+
+    // Timer 1 in CTC mode at F_CPU, compare A every 1ms
+    TCCR1A = 0x00;
+    OCR1A = (SCHED_TICK_COUNTS - 1);
+    TCNT1 = 0;
+    TCCR1B = ((1<<WGM12)|(1<<CS10));
+    TIMSK1 = (1<<OCIE1A);
+}
+
+void schedRun(void) {
+    uint8_t task;
+
+    for (;;) {
+        for (task = 0; task < SCHED_TASKS; task++) {
+            if (schedReady & (1<<task)) {
+                schedDispatch(task);
+                break;
+            }
+        }
+
+#ifdef FNIR_SLEEP_ENABLE
+        // Nothing ready, wait for an interrupt to ready a task
+        cli();
+        if (!schedReady) {
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+        sei();
+#endif
+    }
+}
+
+void schedPost(schedTaskId_t task) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        schedReady |= (1<<task);
+    }
+}
+
+void schedYield(void) {
+    uint8_t task;
+    uint8_t limit;
+
+    limit = schedYieldLimit();
+
+    for (task = 0; task < limit; task++) {
+        if (schedReady & (1<<task)) {
+            schedDispatch(task);
+        }
+    }
+}
+
+void schedSleep(void) {
+#ifdef FNIR_SLEEP_ENABLE
+    uint8_t runnable;
+
+    // Tasks schedYield may run are the low bits of the ready flags
+    runnable = (1<<schedYieldLimit()) - 1;
+
+    cli();
+    if (!(schedReady & runnable) && !schedMarked) {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+#endif
+}
+
+void schedMark(void) {
+    if (!schedMarked) {
+        schedMarkTime = schedNow();
+        schedMarked = 1;
+    }
+}
+
+void schedMarkServiced(void) {
+    uint32_t latency;
+
+    if (!schedMarked) {
+        return;
+    }
+
+    latency = schedNow() - schedMarkTime;
+    schedMarked = 0;
+
+    if (latency > schedWorstMark) {
+        schedWorstMark = latency;
+    }
+}
+
+uint32_t schedWorstLatency(void) {
+    return (schedWorstMark / SCHED_COUNTS_PER_US);
+}
+
+uint32_t schedNow(void) {
+    uint32_t ticks;
+    uint16_t counts;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ticks = schedTicks;
+        counts = TCNT1;
+
+        // Count wrapped but tick interrupt has not run yet
+        if ((TIFR1 & (1<<OCF1A)) && (counts < (SCHED_TICK_COUNTS/2))) {
+            ticks++;
+        }
+    }
+
+    return ((ticks * SCHED_TICK_COUNTS) + counts);
+}
+
+uint32_t schedMillis(void) {
+    uint32_t ticks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ticks = schedTicks;
+    }
+
+    return (ticks);
+}
+
+uint32_t schedWorst(schedTaskId_t task) {
+    if (task >= SCHED_TASKS) {
+        return (0);
+    }
+
+    return (schedWorstCounts[task] / SCHED_COUNTS_PER_US);
+}
+
+void schedClearWorst(void) {
+    uint8_t task;
+
+    for (task = 0; task < SCHED_TASKS; task++) {
+        schedWorstCounts[task] = 0;
+    }
+
+    schedWorstMark = 0;
+}
+
+/** Returns number of tasks schedYield may run
+*
+* Tasks ahead of both the running task and \c SCHED_TASK_ACQUIRE.
+*/
+static uint8_t schedYieldLimit(void) {
+    return ((schedCurrent < SCHED_TASK_ACQUIRE) ? schedCurrent : SCHED_TASK_ACQUIRE);
+}
+
+/** Runs one task and records its run time
+*
+* @param task Ready task to run, its ready flag is cleared first.
+*/
+static void schedDispatch(uint8_t task) {
+    uint8_t previous;
+    uint32_t start;
+    uint32_t elapsed;
+    schedTask_t function;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        schedReady &= ~(1<<task);
+    }
+
+    previous = schedCurrent;
+    schedCurrent = task;
+    function = (schedTask_t) pgm_read_word(&schedTable[task]);
+
+    start = schedNow();
+    function();
+    elapsed = schedNow() - start;
+
+    if (elapsed > schedWorstCounts[task]) {
+        schedWorstCounts[task] = elapsed;
+    }
+
+    schedCurrent = previous;
+}
+
+/** Counts milliseconds and readies periodic tasks
+*/
+ISR(TIMER1_COMPA_vect) {
+    static uint16_t housekeepingCount = 0;
+
+    schedTicks++;
+    schedReady |= (1<<SCHED_TASK_USB);
+
+    if (++housekeepingCount >= SCHED_HOUSEKEEPING_MS) {
+        housekeepingCount = 0;
+        schedReady |= (1<<SCHED_TASK_HOUSEKEEPING);
+    }
+}
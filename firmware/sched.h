@@ -0,0 +1,135 @@
+/** @file sched.h
+* @brief Cooperative task scheduler
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Run to completion scheduler driving the firmware after startup. Each task
+* has one ready flag, set with \ref schedPost from tasks or interrupts, and
+* tasks are prioritised by their number: whenever the scheduler looks for
+* work it runs the lowest numbered ready task, so a long processing step can
+* delay USB servicing by at most one task run. Tasks waiting on hardware,
+* such as an adc conversion, call \ref schedYield to let the USB task run in
+* the meantime.
+*
+* Timer 1 counts CPU cycles and provides a 1ms tick which readies the USB
+* task every millisecond and the housekeeping task every
+* \c SCHED_HOUSEKEEPING_MS. Tick and count together form a cycle time base,
+* used to record the worst case run time of every task, which wraps every
+* 2^32 cycles (268s at 16MHz) so only differences of it are meaningful.
+*
+* With \c FNIR_SLEEP_ENABLE the CPU idle sleeps whenever no task can run,
+* both in the scheduler and in \ref schedSleep while a task waits on
+* hardware. Any interrupt wakes it: the 1ms tick, USB (control requests are
+* handled in the USB interrupt, so sleeping adds no latency to them) or a
+* hardware event such as adc end of conversion. Interrupts signalling such
+* an event call \ref schedMark and the waiting task calls
+* \ref schedMarkServiced once it starts work on it, recording the worst
+* wake to work latency.
+*/
+
+/** Tasks in priority order, highest first.
+*
+*/
+typedef enum {
+    SCHED_TASK_USB, /**< LUFA device and CDC servicing */
+    SCHED_TASK_ACQUIRE, /**< One step of the measurement scan */
+    SCHED_TASK_PROCESS, /**< Processing and reporting of a scanned channel */
+    SCHED_TASK_COMMAND, /**< Host command parsing */
+    SCHED_TASK_HOUSEKEEPING, /**< Status LED and connection upkeep */
+    SCHED_TASKS
+} schedTaskId_t;
+
+/** Task function, runs to completion */
+typedef void (*schedTask_t)(void);
+
+#ifndef SCHED_HOUSEKEEPING_MS
+#define SCHED_HOUSEKEEPING_MS 250 /**< Milliseconds between housekeeping runs */
+#endif
+
+#define SCHED_COUNTS_PER_US (F_CPU/1000000UL) /**< Time base counts per microsecond, timer 1 runs at F_CPU */
+
+/** Initializes scheduler.
+*
+* Starts timer 1 tick, clears all ready flags and run times.
+*
+* @param taskTable Task functions in \ref schedTaskId_t order, in flash.
+*/
+extern void schedInit(const schedTask_t *taskTable);
+
+/** Runs ready tasks forever.
+*
+* @return This function never returns.
+*/
+extern void schedRun(void);
+
+/** Marks a task ready to run.
+*
+* Safe to call from interrupts.
+*
+* @param task Task to run.
+*/
+extern void schedPost(schedTaskId_t task);
+
+/** Runs ready tasks of higher priority than the adc users.
+*
+* Called by a task busy waiting on hardware. Only tasks ahead of
+* \c SCHED_TASK_ACQUIRE and of the calling task run, so no other task can
+* start a conversion in the middle of the caller's one.
+*/
+extern void schedYield(void);
+
+/** Returns time base.
+*
+* @return CPU cycles since scheduler start, modulo 2^32.
+*/
+extern uint32_t schedNow(void);
+
+/** Returns milliseconds since scheduler start.
+*
+* @return 1ms ticks counted since \ref schedInit.
+*/
+extern uint32_t schedMillis(void);
+
+/** Returns worst case run time of a task.
+*
+* Time spent in tasks run through \ref schedYield is included in the
+* yielding task's run time.
+*
+* @param task Task to look up.
+* @return     Longest run in microseconds since last cleared.
+*/
+extern uint32_t schedWorst(schedTaskId_t task);
+
+/** Clears worst case run times and wake latency.
+*
+* @return Function does not return a value.
+*/
+extern void schedClearWorst(void);
+
+/** Sleeps until next interrupt unless a task could run.
+*
+* Only tasks that \ref schedYield would run count, and sleep is skipped if
+* \ref schedMark was called since the last \ref schedMarkServiced. Does
+* nothing unless \c FNIR_SLEEP_ENABLE is defined.
+*/
+extern void schedSleep(void);
+
+/** Records time of a hardware event.
+*
+* Called from the interrupt signalling the event a task is waiting on.
+*/
+extern void schedMark(void);
+
+/** Records latency from the last marked event to now.
+*
+* Called by the waiting task when it starts work on the event. Does nothing
+* if no event was marked.
+*/
+extern void schedMarkServiced(void);
+
+/** Returns worst wake to work latency.
+*
+* @return Longest time from \ref schedMark to \ref schedMarkServiced in
+*         microseconds since last cleared.
+*/
+extern uint32_t schedWorstLatency(void);
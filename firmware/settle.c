@@ -0,0 +1,63 @@
+/** @file settle.c
+* @brief LED settle delay table
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_SETTLE_ENABLE
+
+#define SETTLE_CANDIDATES (sizeof(settleCandidates)/sizeof(settleCandidates[0]))
+
+/** Delays tried by the calibration sweep, shortest first, microseconds. */
+static const uint16_t settleCandidates[] PROGMEM = {
+    0, 20, 50, 100, 200, 500, 1000, 2000, 5000
+};
+
+static uint16_t settleDelay[FNIR_SOURCES][2];
+
+void settleInit(void) {
+    memset(settleDelay, 0, sizeof(settleDelay));
+}
+
+uint16_t settleGet(uint8_t source, uint8_t wavelength) {
+    if ((source >= FNIR_SOURCES) || (wavelength > 1)) {
+        return (0);
+    }
+
+    return (settleDelay[source][wavelength]);
+}
+
+uint8_t settleSet(uint8_t source, uint8_t wavelength, uint16_t delay) {
+    if ((source >= FNIR_SOURCES) || (wavelength > 1)) {
+        return (1);
+    }
+
+    // Round up to whole wait steps
+    if (delay > (UINT16_MAX - (SETTLE_STEP_US-1))) {
+        delay = UINT16_MAX - (UINT16_MAX % SETTLE_STEP_US);
+    } else {
+        delay = ((delay + (SETTLE_STEP_US-1)) / SETTLE_STEP_US) * SETTLE_STEP_US;
+    }
+
+    settleDelay[source][wavelength] = delay;
+
+    return (0);
+}
+
+uint16_t settleCandidate(uint8_t index) {
+    if (index >= SETTLE_CANDIDATES) {
+        return (0xFFFF);
+    }
+
+    return (pgm_read_word(&settleCandidates[index]));
+}
+
+void settleWait(uint16_t delay) {
+    for (; delay >= SETTLE_STEP_US; delay -= SETTLE_STEP_US) {
+        _delay_us(SETTLE_STEP_US);
+    }
+}
+
+#endif
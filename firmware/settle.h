@@ -0,0 +1,63 @@
+/** @file settle.h
+* @brief LED settle delay table
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional delay between switching a source LED and starting its conversion,
+* built in with \c FNIR_SETTLE_ENABLE, giving the LED and photodiode filter
+* network time to settle. One delay is kept per source and wavelength.
+*
+* Delays are found by a calibration sweep: each source/wavelength is first
+* measured after \c FNIR_SETTLE_REFERENCE_US, then again after each
+* candidate delay from shortest to longest, and the first candidate whose
+* reading is within \c FNIR_SETTLE_TOLERANCE of the reference is kept. The
+* scan then runs as fast as the actual filter network allows instead of
+* using a conservative guess.
+*/
+
+#ifndef FNIR_SETTLE_REFERENCE_US
+#define FNIR_SETTLE_REFERENCE_US 10000 /**< Long settle time used for reference readings */
+#endif
+
+#ifndef FNIR_SETTLE_TOLERANCE
+#define FNIR_SETTLE_TOLERANCE 16 /**< Largest difference from reference, adc LSBs, counted as settled */
+#endif
+
+#define SETTLE_STEP_US 10 /**< Resolution of settle delays */
+
+/** Initializes settle table to zero delay.
+*
+* @return Function does not return a value.
+*/
+extern void settleInit(void);
+
+/** Returns settle delay of one source and wavelength.
+*
+* @param source     LED source, 0 to FNIR_SOURCES - 1.
+* @param wavelength 0 for 730nm, 1 for 850nm.
+* @return           Settle delay in microseconds.
+*/
+extern uint16_t settleGet(uint8_t source, uint8_t wavelength);
+
+/** Stores settle delay of one source and wavelength.
+*
+* @param source     LED source, 0 to FNIR_SOURCES - 1.
+* @param wavelength 0 for 730nm, 1 for 850nm.
+* @param delay      Settle delay in microseconds, rounded up to
+*                   \ref SETTLE_STEP_US.
+* @return           Returns 0 on success, 1 if source or wavelength is out of range.
+*/
+extern uint8_t settleSet(uint8_t source, uint8_t wavelength, uint16_t delay);
+
+/** Returns a calibration sweep candidate.
+*
+* @param index Candidate number, counting from the shortest delay.
+* @return      Candidate delay in microseconds, or 0xFFFF past the last one.
+*/
+extern uint16_t settleCandidate(uint8_t index);
+
+/** Busy waits for a settle delay.
+*
+* @param delay Delay in microseconds, resolution \ref SETTLE_STEP_US.
+*/
+extern void settleWait(uint16_t delay);
@@ -0,0 +1,103 @@
+/** @file speed.c
+* @brief Adaptive adc conversion speed
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_SPEED_ENABLE
+
+#define SPEED_FRACTION_BITS 4 /**< Fractional bits of offset estimates */
+#define SPEED_OFFSET_LIMIT 2047 /**< Largest offset held, adc LSBs */
+
+static int16_t speedLevel[SPEED_DETECTORS]; // Q4 offsets
+static uint16_t speedSeeded; // One bit per detector, set once offset is valid
+static uint16_t speedPending; // One bit per detector still to calibrate this frame
+static uint8_t speedInterval;
+static uint8_t speedPhase;
+static uint8_t speedEnabled;
+
+void speedInit(void) {
+    speedInterval = FNIR_SPEED_INTERVAL;
+    speedEnabled = 0;
+    speedSeeded = 0;
+    speedPending = 0xFFFF;
+    speedPhase = 0;
+}
+
+void speedEnable(uint8_t enable) {
+    if (enable && !speedEnabled) {
+        speedSeeded = 0;
+        speedPending = 0xFFFF;
+        speedPhase = 0;
+    }
+
+    speedEnabled = enable;
+}
+
+uint8_t speedIsEnabled(void) {
+    return (speedEnabled);
+}
+
+void speedSetInterval(uint8_t frames) {
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    speedInterval = frames;
+    speedPhase = 0;
+}
+
+uint8_t speedCalibrationDue(uint8_t channel, uint8_t detector) {
+    // Advance calibration phase once per frame
+    if (channel == 0) {
+        if (++speedPhase >= speedInterval) {
+            speedPhase = 0;
+            speedPending = 0xFFFF;
+        }
+    }
+
+    if (detector >= SPEED_DETECTORS) {
+        return (0);
+    }
+
+    return ((speedPending & (1U<<detector)) != 0);
+}
+
+void speedUpdate(uint8_t detector, int32_t calibrated, int32_t fast) {
+    int32_t measured;
+
+    if (detector >= SPEED_DETECTORS) {
+        return;
+    }
+
+    measured = fast - calibrated;
+
+    if (measured > SPEED_OFFSET_LIMIT) {
+        measured = SPEED_OFFSET_LIMIT;
+    } else if (measured < -SPEED_OFFSET_LIMIT) {
+        measured = -SPEED_OFFSET_LIMIT;
+    }
+
+    measured <<= SPEED_FRACTION_BITS;
+
+    if (speedSeeded & (1U<<detector)) {
+        speedLevel[detector] += (int16_t)((measured - speedLevel[detector])>>SPEED_SHIFT);
+    } else {
+        speedLevel[detector] = (int16_t) measured;
+        speedSeeded |= (1U<<detector);
+    }
+
+    speedPending &= ~(1U<<detector);
+}
+
+int16_t speedOffset(uint8_t detector) {
+    if ((detector >= SPEED_DETECTORS) || !(speedSeeded & (1U<<detector))) {
+        return (0);
+    }
+
+    return ((speedLevel[detector] + (1<<(SPEED_FRACTION_BITS-1)))>>SPEED_FRACTION_BITS);
+}
+
+#endif
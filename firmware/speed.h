@@ -0,0 +1,81 @@
+/** @file speed.h
+* @brief Adaptive adc conversion speed
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional conversion speed policy, built in with \c FNIR_SPEED_ENABLE.
+* In \c AUTO_CALIBRATE mode the adc spends half of every conversion
+* measuring and removing its own offset. With the policy enabled signal
+* conversions run in \c DOUBLE_SPEED instead, roughly halving conversion time,
+* and the offset is measured on device: every N frames each detector (adc
+* input) is converted once in each mode with the LEDs off, and the difference
+* is averaged into a per detector offset subtracted from every double speed
+* reading. Offsets drift with temperature slowly, so a long interval keeps
+* close to calibrated accuracy at nearly twice the throughput.
+*
+* Offsets are held in Q4, 2 bytes per detector.
+*/
+
+#define SPEED_DETECTORS 16 /**< Detectors tracked, one per unipolar adc input */
+
+#ifndef FNIR_SPEED_INTERVAL
+#define FNIR_SPEED_INTERVAL 32 /**< Default frames between offset calibrations */
+#endif
+
+#define SPEED_SHIFT 2 /**< Averaging shift, each calibration moves offset 1/4 of the way */
+
+/** Initializes speed policy.
+*
+* Loads default interval and leaves policy disabled, so every conversion is
+* auto calibrated.
+*
+* @return Function does not return a value.
+*/
+extern void speedInit(void);
+
+/** Enables or disables double speed conversions.
+*
+* Every detector is calibrated again in the next frame when enabled.
+*
+* @param enable Nonzero for double speed with on device offset correction.
+*/
+extern void speedEnable(uint8_t enable);
+
+/** Reports whether double speed conversions are enabled.
+*
+* @return Nonzero when signal conversions run at double speed.
+*/
+extern uint8_t speedIsEnabled(void);
+
+/** Sets number of frames between offset calibrations.
+*
+* @param frames Calibration interval, zero is treated as 1.
+*/
+extern void speedSetInterval(uint8_t frames);
+
+/** Decides whether a detector needs an offset calibration.
+*
+* Must be called once per channel per frame, in scan order, so the
+* calibration phase advances each time channel 0 is processed. Each detector
+* is only due once per calibration frame however many channels share it.
+*
+* @param channel  Channel being scanned.
+* @param detector Detector (adc input) of the channel.
+* @return         Returns nonzero if the detector should be calibrated.
+*/
+extern uint8_t speedCalibrationDue(uint8_t channel, uint8_t detector);
+
+/** Folds an offset calibration into a detector's estimate.
+*
+* @param detector   Detector (adc input) calibrated.
+* @param calibrated Reading in \c AUTO_CALIBRATE mode.
+* @param fast       Reading of the same input in \c DOUBLE_SPEED mode.
+*/
+extern void speedUpdate(uint8_t detector, int32_t calibrated, int32_t fast);
+
+/** Returns current offset of a detector's double speed readings.
+*
+* @param detector Detector (adc input).
+* @return         Offset to subtract, rounded to whole adc counts.
+*/
+extern int16_t speedOffset(uint8_t detector);
@@ -8,8 +8,8 @@
 #include "includes.h"
 
 void spiInit(void) {
-    
-    SPCR |= ((1<<SPE) | (1<<DORD) | (1<<MSTR) | (1<<SPR0)); // Enable, LSB first, master, 16x prescaler
+    SPCR |= ((1<<SPE) | (1<<MSTR)); // Enable, master, 4x prescaler, bit order set per transaction
+    SPSR &= ~(1<<SPI2X);
 
     // Flush SPI buffers
     (void) spiXfr(0x00);
@@ -24,3 +24,40 @@ uint8_t spiXfr(uint8_t byte) {
 
     return (SPDR);
 }
+
+void spiTransfer(spiTransaction_t *transaction) {
+    uint8_t index;
+    uint8_t received;
+
+    if (transaction->flags & SPI_MSB_FIRST) {
+        SPCR &= ~(1<<DORD);
+    } else {
+        SPCR |= (1<<DORD);
+    }
+
+    spiSelect(transaction, 1);
+
+    for (index = 0; index < transaction->length; index++) {
+        received = spiXfr((transaction->txBuffer != NULL) ? transaction->txBuffer[index] : 0x00);
+
+        if (transaction->rxBuffer != NULL) {
+            transaction->rxBuffer[index] = received;
+        }
+    }
+
+    if (!(transaction->flags & SPI_HOLD_SELECT)) {
+        spiSelect(transaction, 0);
+    }
+}
+
+void spiSelect(spiTransaction_t *transaction, uint8_t select) {
+    if (transaction->csPort == NULL) {
+        return;
+    }
+
+    if (!select == !(transaction->flags & SPI_SELECT_HIGH)) {
+        *transaction->csPort &= ~transaction->csMask;
+    } else {
+        *transaction->csPort |= transaction->csMask;
+    }
+}
@@ -5,8 +5,35 @@
 * @date 8/2014
 *
 * Created for rov project but imported and edited for fNIR imager project.
+*
+* Transfers are described by \ref spiTransaction_t descriptors and clocked
+* out with \ref spiTransfer, which selects the descriptor's chip, sets its bit
+* order and polls each byte. At F_CPU/4 a byte takes 32 CPU cycles, less than
+* an interrupt per byte would cost, and the longest transfer on the bus is a
+* few microseconds, so nothing is gained by handing the bus to an interrupt.
+*
+* The bus runs at F_CPU/4, 4MHz at 16MHz, the fastest serial clock the
+* LTC2494 accepts.
 */
 
+#define SPI_HOLD_SELECT (1<<0) /**< Descriptor flag, leave chip selected after transaction */
+#define SPI_SELECT_HIGH (1<<1) /**< Descriptor flag, chip is selected by driving its pin high */
+#define SPI_MSB_FIRST (1<<2) /**< Descriptor flag, send most significant bit first as the LTC2494 and dataflash expect */
+
+/** SPI transaction descriptor
+*
+* Received bytes may overwrite sent ones in place, each byte is only
+* received once it has gone out.
+*/
+typedef struct {
+    uint8_t *txBuffer; /**< Bytes to send, NULL sends zeros */
+    uint8_t *rxBuffer; /**< Buffer for received bytes, NULL discards them */
+    uint8_t length; /**< Bytes to transfer */
+    volatile uint8_t *csPort; /**< Port of chip select pin, NULL if caller selects chip */
+    uint8_t csMask; /**< Chip select pin mask within csPort */
+    uint8_t flags; /**< SPI_HOLD_SELECT, SPI_SELECT_HIGH and SPI_MSB_FIRST bits */
+} spiTransaction_t;
+
 /** SPI initialization routine
 *
 * Initializes hardware SPI system and flushes buffers
@@ -24,3 +51,22 @@ extern void spiInit(void);
 * @return Function returns one byte from slave device
 */
 extern uint8_t spiXfr(uint8_t byte);
+
+/** Runs a transaction
+*
+* Selects the chip, clocks every byte out and in with \ref spiXfr in the
+* descriptor's bit order and deselects the chip unless \c SPI_HOLD_SELECT is
+* set. Blocks until the last byte has been received.
+*
+* @param transaction Descriptor of transfer.
+*/
+extern void spiTransfer(spiTransaction_t *transaction);
+
+/** Drives chip select pin of a transaction
+*
+* Does nothing if the descriptor has no chip select port.
+*
+* @param transaction Transaction whose chip is driven.
+* @param select Nonzero to select chip, zero to deselect it.
+*/
+extern void spiSelect(spiTransaction_t *transaction, uint8_t select);
@@ -0,0 +1,111 @@
+/** @file stats.c
+* @brief Running signal quality statistics
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_STATS_ENABLE
+
+#define STATS_FRACTION_BITS 8 /**< Fractional bits of running means */
+
+/** Running statistics of one channel. */
+typedef struct {
+    int32_t mean[2]; /**< Running 730nm and 850nm mean, Q8 */
+    uint32_t m2[2]; /**< Running 730nm and 850nm sum of squares, counts squared */
+    int32_t dark; /**< Running dark mean, Q8 */
+    uint8_t count; /**< Frames accumulated in current window */
+} statsState_t;
+
+static statsState_t statsState[FNIR_STATS_CHANNELS];
+static uint8_t statsWindow;
+static uint8_t statsEnabled;
+
+void statsInit(void) {
+    statsWindow = FNIR_STATS_WINDOW;
+    statsEnabled = 0;
+}
+
+void statsEnable(uint8_t enable) {
+    if (enable && !statsEnabled) {
+        memset(statsState, 0, sizeof(statsState));
+    }
+
+    statsEnabled = enable;
+}
+
+uint8_t statsIsEnabled(void) {
+    return (statsEnabled);
+}
+
+void statsSetWindow(uint8_t frames) {
+    if (frames < 2) {
+        frames = 2;
+    }
+
+    statsWindow = frames;
+    memset(statsState, 0, sizeof(statsState));
+}
+
+uint8_t statsUpdate(uint8_t channel, int16_t *sample, int16_t dark, statsRecord_t *record) {
+    statsState_t *state;
+    uint8_t wavelength;
+    int32_t x;
+    int32_t delta;
+    int32_t delta2;
+    uint32_t magnitude;
+    uint32_t magnitude2;
+    uint32_t product;
+    uint32_t variance;
+
+    if (channel >= FNIR_STATS_CHANNELS) {
+        return (0);
+    }
+
+    state = &statsState[channel];
+    state->count++;
+
+    for (wavelength = 0; wavelength < 2; wavelength++) {
+        // Welford update, mean kept in Q8
+        x = ((int32_t) sample[wavelength])<<STATS_FRACTION_BITS;
+        delta = x - state->mean[wavelength];
+        state->mean[wavelength] += delta / state->count;
+        delta2 = x - state->mean[wavelength];
+
+        // Both deltas share a sign and are under 2^16 counts, so their
+        // magnitudes dropped to Q0 multiply without overflowing 32 bits
+        magnitude = (uint32_t) ((delta < 0) ? -delta : delta)>>STATS_FRACTION_BITS;
+        magnitude2 = (uint32_t) ((delta2 < 0) ? -delta2 : delta2)>>STATS_FRACTION_BITS;
+        product = magnitude * magnitude2;
+
+        if (state->m2[wavelength] > (UINT32_MAX - product)) {
+            state->m2[wavelength] = UINT32_MAX;
+        } else {
+            state->m2[wavelength] += product;
+        }
+    }
+
+    x = ((int32_t) dark)<<STATS_FRACTION_BITS;
+    state->dark += (x - state->dark) / state->count;
+
+    if (state->count < statsWindow) {
+        return (0);
+    }
+
+    // Window complete, build record and start next window
+    for (wavelength = 0; wavelength < 2; wavelength++) {
+        record->mean[wavelength] = q15Saturate(state->mean[wavelength]>>STATS_FRACTION_BITS);
+
+        variance = state->m2[wavelength] / (state->count - 1);
+        record->variance[wavelength] = (variance > UINT16_MAX) ? UINT16_MAX : (uint16_t) variance;
+    }
+
+    record->dark = q15Saturate(state->dark>>STATS_FRACTION_BITS);
+
+    memset(state, 0, sizeof(statsState_t));
+
+    return (1);
+}
+
+#endif
@@ -0,0 +1,74 @@
+/** @file stats.h
+* @brief Running signal quality statistics
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional per-channel statistics, built in with \c FNIR_STATS_ENABLE. The
+* dark subtracted 730nm and 850nm samples of each channel are accumulated
+* with Welford's running mean and variance, along with the mean dark level,
+* over a window of a configurable number of frames. When a channel's window
+* is complete a compact signal quality record is produced and the window
+* restarts, so records arrive at a low rate next to the full rate data.
+*
+* A poorly coupled optode shows up as a low mean, a high variance or a dark
+* level close to the lit level, within one window of being placed.
+*
+* Means are held in Q8 and sums of squares in whole counts squared,
+* saturating rather than wrapping, so deviations over the full adc range are
+* accumulated. State is 21 bytes per channel, 336 bytes for all 16
+* channels, so on the ATmega16u2 this does not fit alongside the filter bank;
+* reduce \c FNIR_STATS_CHANNELS to monitor a subset.
+*/
+
+#ifndef FNIR_STATS_CHANNELS
+#define FNIR_STATS_CHANNELS 16 /**< Channels monitored, starting at channel 0 */
+#endif
+
+#ifndef FNIR_STATS_WINDOW
+#define FNIR_STATS_WINDOW 8 /**< Default frames per statistics window */
+#endif
+
+/** Signal quality record of one channel over one window. */
+typedef struct {
+    int16_t mean[2]; /**< Mean dark subtracted 730nm and 850nm level */
+    uint16_t variance[2]; /**< Variance of 730nm and 850nm level, saturated */
+    int16_t dark; /**< Mean dark level */
+} statsRecord_t;
+
+/** Initializes statistics.
+*
+* Loads default window length and leaves statistics disabled.
+*
+* @return Function does not return a value.
+*/
+extern void statsInit(void);
+
+/** Enables or disables statistics.
+*
+* All windows restart when enabled.
+*
+* @param enable Nonzero to accumulate statistics.
+*/
+extern void statsEnable(uint8_t enable);
+
+/** Reports whether statistics are enabled.
+*
+* @return Nonzero when statistics are being accumulated.
+*/
+extern uint8_t statsIsEnabled(void);
+
+/** Sets window length and restarts all windows.
+*
+* @param frames Frames per window, 2 to 255. Out of range values are clamped.
+*/
+extern void statsSetWindow(uint8_t frames);
+
+/** Adds one frame of a channel to its window.
+*
+* @param channel Channel the samples were taken from.
+* @param sample  Dark subtracted 730nm and 850nm samples.
+* @param dark    Dark level of the same frame.
+* @param record  Filled in when the window completes.
+* @return        Returns nonzero if the window completed and record is valid.
+*/
+extern uint8_t statsUpdate(uint8_t channel, int16_t *sample, int16_t dark, statsRecord_t *record);
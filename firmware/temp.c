@@ -0,0 +1,119 @@
+/** @file temp.c
+* @brief Temperature monitoring and drift compensation
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_TEMP_ENABLE
+
+static int16_t tempCoefficient[FNIR_CHANNELS][2];
+static int16_t tempTemperature;
+static int16_t tempReferenceTemperature;
+static int16_t tempDarkTemperature; // Temperature at last dark invalidation
+static uint8_t tempInterval;
+static uint8_t tempPhase;
+static uint8_t tempEnabled;
+static uint8_t tempReferenceValid;
+
+void tempInit(void) {
+    memset(tempCoefficient, 0, sizeof(tempCoefficient));
+    tempInterval = FNIR_TEMP_INTERVAL;
+    tempPhase = 0;
+    tempEnabled = 0;
+    tempReferenceValid = 0;
+}
+
+void tempEnable(uint8_t enable) {
+    if (enable && !tempEnabled) {
+        tempReferenceValid = 0;
+        tempPhase = 0;
+    }
+
+    tempEnabled = enable;
+}
+
+uint8_t tempIsEnabled(void) {
+    return (tempEnabled);
+}
+
+void tempSetInterval(uint8_t frames) {
+    if (frames == 0) {
+        frames = 1;
+    }
+
+    tempInterval = frames;
+    tempPhase = 0;
+}
+
+uint8_t tempConversionDue(void) {
+    uint8_t due;
+
+    due = (tempPhase == 0);
+
+    if (++tempPhase >= tempInterval) {
+        tempPhase = 0;
+    }
+
+    return (due);
+}
+
+void tempUpdate(int16_t temperature) {
+    tempTemperature = temperature;
+
+    // First reading after enabling becomes the reference
+    if (!tempReferenceValid) {
+        tempSetReference();
+    }
+
+#ifdef FNIR_DARK_TRACK_ENABLE
+    // Dark current follows temperature, refresh estimates on a large change
+    if (abs(tempTemperature - tempDarkTemperature) > FNIR_TEMP_DARK_THRESHOLD) {
+        tempDarkTemperature = tempTemperature;
+        darkInvalidate();
+    }
+#endif
+}
+
+int16_t tempRead(void) {
+    return (tempTemperature);
+}
+
+int16_t tempReference(void) {
+    return (tempReferenceTemperature);
+}
+
+void tempSetReference(void) {
+    tempReferenceTemperature = tempTemperature;
+    tempDarkTemperature = tempTemperature;
+    tempReferenceValid = 1;
+}
+
+uint8_t tempSetCoefficients(uint8_t channel, int16_t *coefficient) {
+    if (channel >= FNIR_CHANNELS) {
+        return (1);
+    }
+
+    tempCoefficient[channel][0] = coefficient[0];
+    tempCoefficient[channel][1] = coefficient[1];
+
+    return (0);
+}
+
+void tempCorrect(uint8_t channel, int32_t *sample) {
+    int32_t drift;
+    uint8_t wavelength;
+
+    if (!tempReferenceValid || (channel >= FNIR_CHANNELS)) {
+        return;
+    }
+
+    drift = (int32_t) tempTemperature - tempReferenceTemperature;
+
+    for (wavelength = 0; wavelength < 2; wavelength++) {
+        sample[wavelength] -= (drift * tempCoefficient[channel][wavelength])>>TEMP_COEFF_SHIFT;
+    }
+}
+
+#endif
@@ -0,0 +1,107 @@
+/** @file temp.h
+* @brief Temperature monitoring and drift compensation
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional use of the LTC2494 internal temperature sensor, built in with
+* \c FNIR_TEMP_ENABLE. When enabled the scan interleaves one
+* \c INTERNAL_TEMP_CH conversion at the start of every Nth frame and the
+* reading is reported to the host.
+*
+* The reading also drives a linear drift correction of the dark subtracted
+* samples. Each channel and wavelength has a Q8 coefficient giving the change
+* in signal, in adc counts, per adc count of temperature change; the
+* correction is taken relative to a reference temperature captured from the
+* first reading after enabling or on host request. Coefficients default to
+* zero, leaving samples untouched until the host loads them.
+*
+* When dark tracking is built in, a temperature change larger than
+* \c FNIR_TEMP_DARK_THRESHOLD since the last dark refresh invalidates the dark
+* estimates. State is 4 bytes per channel plus 10 bytes.
+*/
+
+#ifndef FNIR_TEMP_INTERVAL
+#define FNIR_TEMP_INTERVAL 8 /**< Default frames between temperature conversions */
+#endif
+
+#ifndef FNIR_TEMP_DARK_THRESHOLD
+#define FNIR_TEMP_DARK_THRESHOLD 32 /**< Temperature change, adc counts, forcing dark refresh */
+#endif
+
+#define TEMP_COEFF_SHIFT 8 /**< Fractional bits in a drift coefficient */
+
+/** Initializes temperature monitoring.
+*
+* Loads default interval, clears drift coefficients and leaves temperature
+* conversions disabled.
+*
+* @return Function does not return a value.
+*/
+extern void tempInit(void);
+
+/** Enables or disables temperature conversions and drift correction.
+*
+* The reference temperature is recaptured from the first reading after
+* enabling.
+*
+* @param enable Nonzero to interleave temperature conversions.
+*/
+extern void tempEnable(uint8_t enable);
+
+/** Reports whether temperature conversions are enabled.
+*
+* @return Nonzero when temperature is being measured.
+*/
+extern uint8_t tempIsEnabled(void);
+
+/** Sets number of frames between temperature conversions.
+*
+* @param frames Conversion interval, zero is treated as 1.
+*/
+extern void tempSetInterval(uint8_t frames);
+
+/** Decides whether a temperature conversion is due.
+*
+* Must be called once per frame, advances the interval counter.
+*
+* @return Returns nonzero if a temperature conversion should be taken.
+*/
+extern uint8_t tempConversionDue(void);
+
+/** Stores a new temperature reading.
+*
+* @param temperature Raw adc reading of the internal temperature channel.
+*/
+extern void tempUpdate(int16_t temperature);
+
+/** Returns last temperature reading.
+*
+* @return Raw adc reading of the internal temperature channel.
+*/
+extern int16_t tempRead(void);
+
+/** Returns reference temperature drift is corrected against.
+*
+* @return Raw adc reading captured as reference.
+*/
+extern int16_t tempReference(void);
+
+/** Captures last reading as the reference temperature. */
+extern void tempSetReference(void);
+
+/** Loads drift coefficients of one channel.
+*
+* @param channel     Channel to set.
+* @param coefficient Q8 730nm and 850nm drift, counts per temperature count.
+* @return            Returns 0 on success, 1 if channel is out of range.
+*/
+extern uint8_t tempSetCoefficients(uint8_t channel, int16_t *coefficient);
+
+/** Removes temperature drift from one channel's samples in place.
+*
+* Does nothing until a reference temperature has been captured.
+*
+* @param channel Channel the samples were taken from.
+* @param sample  Dark subtracted 730nm and 850nm levels in adc LSBs.
+*/
+extern void tempCorrect(uint8_t channel, int32_t *sample);
@@ -0,0 +1,124 @@
+/** @file usbstat.c
+* @brief USB transport counters
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_USB_STATS_ENABLE
+
+#define USB_STAT_INCREMENT(counter) do {if ((counter) != 0xFFFF) {(counter)++;}} while (0) /**< Saturating 16 bit count */
+
+static usbStat_t usbStat;
+static uint32_t usbStatBlocked; // CPU cycles spent blocked
+
+static int usbStatPutchar(char c, FILE *stream);
+static int usbStatGetchar(FILE *stream);
+
+void usbStatInit(void) {
+    memset(&usbStat, 0, sizeof(usbStat));
+    usbStatBlocked = 0;
+}
+
+void usbStatCreateStream(USB_ClassInfo_CDC_Device_t *cdcInterface, FILE *stream) {
+    fdev_setup_stream(stream, usbStatPutchar, usbStatGetchar, _FDEV_SETUP_RW);
+    fdev_set_udata(stream, cdcInterface);
+}
+
+void usbStatFlush(USB_ClassInfo_CDC_Device_t *cdcInterface) {
+    uint16_t length;
+
+    if ((USB_DeviceState != DEVICE_STATE_Configured) || !(cdcInterface->State.LineEncoding.BaudRateBPS)) {
+        return;
+    }
+
+    Endpoint_SelectEndpoint(cdcInterface->Config.DataINEndpoint.Address);
+    length = Endpoint_BytesInEndpoint();
+
+    // Same test CDC_Device_USBTask makes, flushed here so only sent packets count
+    if ((length == 0) || !Endpoint_IsINReady()) {
+        return;
+    }
+
+    if (CDC_Device_Flush(cdcInterface) != ENDPOINT_READYWAIT_NoError) {
+        return;
+    }
+
+    USB_STAT_INCREMENT(usbStat.packets);
+
+    if (length < cdcInterface->Config.DataINEndpoint.Size) {
+        USB_STAT_INCREMENT(usbStat.shortPackets);
+    }
+}
+
+void usbStatFrameDelayed(void) {
+    USB_STAT_INCREMENT(usbStat.framesDelayed);
+}
+
+void usbStatFrameDropped(void) {
+    USB_STAT_INCREMENT(usbStat.framesDropped);
+}
+
+void usbStatRead(usbStat_t *stat) {
+    *stat = usbStat;
+    stat->blockedCycles = usbStatBlocked;
+}
+
+/** Writes one char to the IN endpoint, counting packets and waits
+*
+* @param c      Char to write.
+* @param stream Stream, user data is the CDC interface.
+* @return       Returns 0 on success, \c _FDEV_ERR if the char was lost.
+*/
+static int usbStatPutchar(char c, FILE *stream) {
+    USB_ClassInfo_CDC_Device_t *cdcInterface;
+    uint32_t start;
+
+    cdcInterface = (USB_ClassInfo_CDC_Device_t *) fdev_get_udata(stream);
+
+    if ((USB_DeviceState == DEVICE_STATE_Configured) && cdcInterface->State.LineEncoding.BaudRateBPS) {
+        Endpoint_SelectEndpoint(cdcInterface->Config.DataINEndpoint.Address);
+
+        // Send full bank here so the wait for the host can be seen and timed
+        if (!Endpoint_IsReadWriteAllowed()) {
+            Endpoint_ClearIN();
+            USB_STAT_INCREMENT(usbStat.packets);
+
+            if (!Endpoint_IsReadWriteAllowed()) {
+                USB_STAT_INCREMENT(usbStat.waits);
+                start = schedNow();
+                (void) Endpoint_WaitUntilReady();
+                usbStatBlocked += schedNow() - start;
+            }
+        }
+    }
+
+    if (CDC_Device_SendByte(cdcInterface, (uint8_t) c) != ENDPOINT_READYWAIT_NoError) {
+        USB_STAT_INCREMENT(usbStat.droppedBytes);
+        return (_FDEV_ERR);
+    }
+
+    usbStat.bytes++;
+
+    return (0);
+}
+
+/** Reads one char from the OUT endpoint
+*
+* @param stream Stream, user data is the CDC interface.
+* @return       Char received, \c _FDEV_EOF if none is waiting.
+*/
+static int usbStatGetchar(FILE *stream) {
+    int16_t receivedByte;
+
+    receivedByte = CDC_Device_ReceiveByte((USB_ClassInfo_CDC_Device_t *) fdev_get_udata(stream));
+
+    if (receivedByte < 0) {
+        return (_FDEV_EOF);
+    }
+
+    return (receivedByte);
+}
+
+#endif
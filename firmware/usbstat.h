@@ -0,0 +1,76 @@
+/** @file usbstat.h
+* @brief USB transport counters
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional instrumentation of the CDC data path, built in with
+* \c FNIR_USB_STATS_ENABLE, to tell whether missing throughput is lost to
+* the adc, the CPU or a host that is slow to drain the IN endpoint.
+*
+* \ref usbStatCreateStream replaces LUFA's CDC stream with one whose put
+* function does the bank handling of \c CDC_Device_SendByte itself: when the
+* IN bank is full it sends it, counts a full packet and, if the host has not
+* yet taken the previous packet, counts and times the
+* \c Endpoint_WaitUntilReady block with the scheduler time base. A partly
+* filled bank is flushed and counted by \ref usbStatFlush once the endpoint
+* is ready, packets shorter than the endpoint as short packets. Data lines held back or dropped
+* because the host was not draining are counted by the reporting code.
+*
+* Counters saturate rather than wrap. State is 24 bytes.
+*/
+
+/** Transport counters.
+*
+*/
+typedef struct {
+    uint32_t bytes; /**< Bytes written to the IN endpoint */
+    uint16_t packets; /**< IN packets sent */
+    uint16_t shortPackets; /**< IN packets shorter than the endpoint */
+    uint16_t waits; /**< Times a write blocked for the host to take a packet */
+    uint32_t blockedCycles; /**< CPU cycles spent blocked */
+    uint16_t droppedBytes; /**< Bytes lost to a write error or disconnect */
+    uint16_t framesDelayed; /**< Data lines held back instead of sent at once */
+    uint16_t framesDropped; /**< Data lines lost */
+} usbStat_t;
+
+/** Clears every counter.
+*
+* @return Function does not return a value.
+*/
+extern void usbStatInit(void);
+
+/** Sets up counting character stream on a CDC interface.
+*
+* Drop in replacement for \c CDC_Device_CreateStream.
+*
+* @param cdcInterface CDC interface to read and write.
+* @param stream       Stream to set up.
+*/
+extern void usbStatCreateStream(USB_ClassInfo_CDC_Device_t *cdcInterface, FILE *stream);
+
+/** Flushes and counts a partly filled IN bank.
+*
+* Call just before \c CDC_Device_USBTask, which would otherwise send the
+* bank uncounted. Nothing is counted unless the bank was actually sent.
+*
+* @param cdcInterface CDC interface about to be serviced.
+*/
+extern void usbStatFlush(USB_ClassInfo_CDC_Device_t *cdcInterface);
+
+/** Counts a data line held back for later sending.
+*
+* @return Function does not return a value.
+*/
+extern void usbStatFrameDelayed(void);
+
+/** Counts a lost data line.
+*
+* @return Function does not return a value.
+*/
+extern void usbStatFrameDropped(void);
+
+/** Reads every counter.
+*
+* @param stat Receives counters.
+*/
+extern void usbStatRead(usbStat_t *stat);
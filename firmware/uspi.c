@@ -0,0 +1,52 @@
+/** @file uspi.c
+* @brief USART1 master SPI transport
+* @author Jeremy Ruhland
+* @date 8/2014
+*/
+
+#include "includes.h"
+
+#ifdef FNIR_ADC_USART_ENABLE
+
+void uspiInit(void) {
+    SerialSPI_Init((USART_SPI_SCK_LEAD_RISING | USART_SPI_SAMPLE_LEADING | USART_SPI_ORDER_MSB_FIRST),
+                   USPI_BAUD);
+}
+
+uint8_t uspiTransfer(spiTransaction_t *transaction) {
+    uint8_t txIndex = 0;
+    uint8_t rxIndex = 0;
+    uint8_t received;
+
+    if (transaction->length == 0) {
+        return (1);
+    }
+
+    spiSelect(transaction, 1);
+
+    // Keep transmit buffer full so bytes follow each other without a gap
+    while (rxIndex < transaction->length) {
+        if ((txIndex < transaction->length) && (UCSR1A & (1<<UDRE1))) {
+            UDR1 = (transaction->txBuffer != NULL) ? transaction->txBuffer[txIndex] : 0x00;
+            txIndex++;
+        }
+
+        if (UCSR1A & (1<<RXC1)) {
+            received = UDR1;
+
+            if (transaction->rxBuffer != NULL) {
+                transaction->rxBuffer[rxIndex] = received;
+            }
+
+            rxIndex++;
+        }
+    }
+
+    if (!(transaction->flags & SPI_HOLD_SELECT)) {
+        spiSelect(transaction, 0);
+    }
+
+    return (0);
+}
+
+#endif
@@ -0,0 +1,37 @@
+/** @file uspi.h
+* @brief USART1 master SPI transport
+* @author Jeremy Ruhland
+* @date 8/2014
+*
+* Optional adc transport on USART1 in master SPI mode, built in with
+* \c FNIR_ADC_USART_ENABLE. The USART transmitter is double buffered, so the
+* next byte is loaded while the current one shifts out and the 3 byte
+* LTC2494 command and readout stream back to back with no gap between bytes.
+* The hardware SPI block is left free for another peripheral.
+*
+* The adc must be wired to XCK1 (PD5), TXD1 (PD3) and RXD1 (PD2). Those pins
+* otherwise drive LED sources 1 and 2, so with this transport the board maps
+* source 1 to PD6 and PD7 instead and montages are limited to 2 sources; see
+* \c BOARD_LED_PIN in FnirBoard.h.
+*/
+
+#define USPI_BAUD 4000000UL /**< Serial clock, fastest the LTC2494 accepts */
+
+/** Initializes USART1 as an SPI master
+*
+* Uses the same clock polarity and phase as the hardware SPI block, MSB
+* first as the adc expects.
+*
+* @return Function does not return a value.
+*/
+extern void uspiInit(void);
+
+/** Runs one transaction on USART1
+*
+* Takes the same descriptor as \ref spiTransfer, honouring its chip select
+* and hold flag, and returns when it is complete.
+*
+* @param transaction Descriptor of transfer.
+* @return Returns 0 on success, 1 if length is zero.
+*/
+extern uint8_t uspiTransfer(spiTransaction_t *transaction);